@@ -0,0 +1,95 @@
+/*
+ Minimal benchmark harness for the TextureStore bench suite.
+
+ Every suite registers itself with RPH_BENCH_SUITE and reports one Result per measurement.
+ Results are printed as a table and can be written to a JSON file to track them over time.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace bench {
+
+    typedef std::vector<std::pair<std::string, double>> Params;
+
+    struct Result {
+        std::string                                 suite;
+        std::string                                 name;
+        Params                                      params;
+        uint64_t                                    ops = 0;
+        double                                      seconds = 0.0;
+        //! optional, for throughput numbers
+        uint64_t                                    bytes = 0;
+
+        double getNanosPerOp() const { return ops > 0 ? seconds * 1e9 / double( ops ) : 0.0; }
+        double getOpsPerSecond() const { return seconds > 0.0 ? double( ops ) / seconds : 0.0; }
+        double getBytesPerSecond() const { return seconds > 0.0 ? double( bytes ) / seconds : 0.0; }
+    };
+
+    struct Options {
+        //! smaller sizes, for smoke testing the suite itself
+        bool        quick = false;
+        //! scratch directory for generated files
+        std::string tempDir;
+    };
+
+    class Context {
+      public:
+        Context( const std::string &suite, const Options &options, std::vector<Result> &results )
+            : mSuite( suite ), mOptions( options ), mResults( results ) {}
+
+        const Options&  getOptions() const { return mOptions; }
+        bool            isQuick() const { return mOptions.quick; }
+        //! a directory of its own for the current suite, created on demand
+        std::string     getTempDir() const;
+
+        //! times fn, which performs ops operations, and records the result
+        Result& measure( const std::string &name, const Params &params, uint64_t ops, const std::function<void()> &fn );
+        //! records a result measured by the suite itself
+        Result& add( const Result &result );
+
+      private:
+        std::string             mSuite;
+        const Options           &mOptions;
+        std::vector<Result>     &mResults;
+    };
+
+    typedef void (*SuiteFn)( Context &context );
+
+    struct Suite {
+        const char  *name;
+        SuiteFn     fn;
+    };
+
+    std::vector<Suite>& getSuites();
+
+    struct SuiteRegistrar {
+        SuiteRegistrar( const char *name, SuiteFn fn ) { getSuites().push_back( Suite{ name, fn } ); }
+    };
+
+    inline double secondsSince( std::chrono::steady_clock::time_point start )
+    {
+        return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+    }
+
+    //! keeps the optimizer from dropping a computed value
+    template<typename T>
+    inline void doNotOptimize( T const &value )
+    {
+        static volatile const void *sink;
+        sink = &value;
+        (void)sink;
+    }
+
+} // namespace bench
+
+#define RPH_BENCH_SUITE( name ) \
+    static void name( bench::Context &context ); \
+    static bench::SuiteRegistrar name##Registrar( #name, &name ); \
+    static void name( bench::Context &context )
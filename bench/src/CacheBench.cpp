@@ -0,0 +1,142 @@
+/*
+ Cache lookups at scale.
+
+ Compares the old string keyed std::map lookups against interned TextureKey handles, with the
+ access pattern fetch() has on every frame: one lookup per stored image. Also covers the
+ cpu tier LruCache that evicted textures are demoted to, and the cost of recording accesses
+ for the warm-start manifest on top of a lookup.
+*/
+
+#include "Bench.h"
+
+#include "rph/AccessManifest.h"
+#include "rph/KeyRegistry.h"
+#include "rph/LruCache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+namespace {
+
+    // stand-in for ci::gl::TextureRef, only the pointer gets copied around
+    typedef std::shared_ptr<int> TextureRef;
+
+    std::vector<std::string> makeUrls( size_t count )
+    {
+        std::vector<std::string> urls;
+        urls.reserve( count );
+        char buf[256];
+        for( size_t i = 0; i < count; ++i ){
+            snprintf( buf, sizeof( buf ), "/Users/installation/Documents/content/collections/set_%04zu/image_%06zu.jpg", i / 100, i );
+            urls.push_back( buf );
+        }
+        return urls;
+    }
+
+    std::vector<size_t> shuffledOrder( size_t count )
+    {
+        std::vector<size_t> order( count );
+        for( size_t i = 0; i < count; ++i ) order[i] = i;
+        std::shuffle( order.begin(), order.end(), std::mt19937( 42 ) );
+        return order;
+    }
+
+} // anonymous namespace
+
+RPH_BENCH_SUITE( CacheLookup )
+{
+    std::vector<size_t> sizes = context.isQuick() ? std::vector<size_t>{ 10000 } : std::vector<size_t>{ 10000, 100000, 1000000 };
+    const size_t lookups = context.isQuick() ? 200000 : 2000000;
+
+    for( size_t count : sizes ){
+        std::vector<std::string> urls = makeUrls( count );
+        std::vector<size_t> order = shuffledOrder( count );
+
+        rph::FormatDescriptor fmt;
+        rph::KeyRegistry registry;
+        std::vector<rph::TextureKey> keys;
+        keys.reserve( count );
+
+        std::map<std::string, TextureRef> byUrl;
+        std::unordered_map<rph::TextureKey, TextureRef> byKey;
+        for( size_t i = 0; i < count; ++i ){
+            TextureRef ref = std::make_shared<int>( int( i ) );
+            byUrl[ urls[i] ] = ref;
+            keys.push_back( registry.intern( urls[i], fmt ) );
+            byKey[ keys.back() ] = ref;
+        }
+
+        size_t hits = 0;
+
+        // what fetch(url) used to do: find() followed by operator[]
+        context.measure( "std::map<string> find+[]", { { "entries", double( count ) } }, lookups, [&](){
+            for( size_t n = 0; n < lookups; ++n ){
+                const std::string &url = urls[ order[ n % count ] ];
+                if( byUrl.find( url ) != byUrl.end() )
+                    hits += byUrl[ url ].use_count() > 0;
+            }
+        } );
+
+        // fetch(url, fmt): intern once, then a single integer keyed lookup
+        context.measure( "intern + find", { { "entries", double( count ) } }, lookups, [&](){
+            for( size_t n = 0; n < lookups; ++n ){
+                auto itr = byKey.find( registry.intern( urls[ order[ n % count ] ], fmt ) );
+                if( itr != byKey.end() ) hits += itr->second.use_count() > 0;
+            }
+        } );
+
+        // fetch(key): the caller holds on to the handle
+        context.measure( "handle find", { { "entries", double( count ) } }, lookups, [&](){
+            for( size_t n = 0; n < lookups; ++n ){
+                auto itr = byKey.find( keys[ order[ n % count ] ] );
+                if( itr != byKey.end() ) hits += itr->second.use_count() > 0;
+            }
+        } );
+
+        // fetch(key) while recording the warm-start manifest
+        rph::AccessManifest manifest;
+        manifest.setRecording( true );
+        context.measure( "handle find + record access", { { "entries", double( count ) } }, lookups, [&](){
+            for( size_t n = 0; n < lookups; ++n ){
+                rph::TextureKey key = keys[ order[ n % count ] ];
+                manifest.record( registry.getUrlId( key ) );
+                auto itr = byKey.find( key );
+                if( itr != byKey.end() ) hits += itr->second.use_count() > 0;
+            }
+        } );
+
+        bench::doNotOptimize( hits );
+    }
+}
+
+RPH_BENCH_SUITE( CpuTier )
+{
+    const size_t count = context.isQuick() ? 10000 : 100000;
+    const size_t entryBytes = 200 * 1024;
+    std::vector<size_t> order = shuffledOrder( count );
+
+    // budget for half the entries, so every other put evicts
+    rph::LruCache<uint32_t, std::shared_ptr<int>> cache( entryBytes * count / 2 );
+    std::shared_ptr<int> value = std::make_shared<int>( 0 );
+
+    context.measure( "put with eviction", { { "entries", double( count ) } }, count, [&](){
+        for( size_t i : order ) cache.put( uint32_t( i ), value, entryBytes );
+    } );
+
+    size_t hits = 0;
+    context.measure( "get, 50% resident", { { "entries", double( count ) } }, count, [&](){
+        std::shared_ptr<int> found;
+        for( size_t i = 0; i < count; ++i ) hits += cache.get( uint32_t( i ), found );
+    } );
+
+    context.measure( "take", { { "entries", double( count ) } }, count, [&](){
+        std::shared_ptr<int> found;
+        for( size_t i = 0; i < count; ++i ) hits += cache.take( uint32_t( i ), found );
+    } );
+
+    bench::doNotOptimize( hits );
+}
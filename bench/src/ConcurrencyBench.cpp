@@ -0,0 +1,124 @@
+/*
+ Multi-producer contention on the concurrent containers.
+
+ Producers push the same way fetch() hands work to the loader, a single consumer drains
+ the container the way the loader thread does.
+*/
+
+#include "Bench.h"
+
+#include "rph/ConcurrentDeque.h"
+#include "rph/ConcurrentMap.h"
+#include "rph/ConcurrentPriorityQueue.h"
+#include "rph/ConcurrentQueue.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+    std::vector<size_t> producerCounts()
+    {
+        size_t cores = std::max( 2u, std::thread::hardware_concurrency() );
+        std::vector<size_t> counts;
+        for( size_t n = 1; n <= cores; n *= 2 ) counts.push_back( n );
+        return counts;
+    }
+
+    //! runs producers that each call produce(producerIndex, i) itemsPerProducer times while consume() drains total items
+    template<typename ProduceFn, typename ConsumeFn>
+    void contend( size_t producers, size_t itemsPerProducer, ProduceFn produce, ConsumeFn consume )
+    {
+        std::atomic<bool> go( false );
+        std::vector<std::thread> threads;
+        for( size_t p = 0; p < producers; ++p ){
+            threads.emplace_back( [&, p](){
+                while( !go ) std::this_thread::yield();
+                for( size_t i = 0; i < itemsPerProducer; ++i ) produce( p, i );
+            } );
+        }
+        go = true;
+        consume( producers * itemsPerProducer );
+        for( auto &t : threads ) t.join();
+    }
+
+} // anonymous namespace
+
+RPH_BENCH_SUITE( ConcurrentContainers )
+{
+    const size_t items = context.isQuick() ? 20000 : 200000;
+
+    for( size_t producers : producerCounts() ){
+        const size_t perProducer = items / producers;
+        const size_t total = perProducer * producers;
+
+        {
+            rph::ConcurrentQueue<size_t> queue;
+            context.measure( "ConcurrentQueue push/wait_and_pop", { { "producers", double( producers ) } }, total, [&](){
+                contend( producers, perProducer,
+                    [&]( size_t, size_t i ){ queue.push( i ); },
+                    [&]( size_t count ){ size_t v; for( size_t n = 0; n < count; ++n ) queue.wait_and_pop( v ); } );
+            } );
+        }
+
+        {
+            rph::ConcurrentDeque<size_t> deque;
+            context.measure( "ConcurrentDeque push_back", { { "producers", double( producers ) } }, total, [&](){
+                contend( producers, perProducer,
+                    [&]( size_t, size_t i ){ deque.push_back( i ); },
+                    [&]( size_t count ){ size_t v; for( size_t n = 0; n < count; ++n ) deque.wait_and_pop_front( v ); } );
+            } );
+        }
+
+        {
+            // unique pushes scan the whole deque, which is what fetch() does for every request
+            const size_t uniqueItems = std::min<size_t>( perProducer, context.isQuick() ? 500 : 2000 );
+            rph::ConcurrentDeque<size_t> deque;
+            context.measure( "ConcurrentDeque push_back unique", { { "producers", double( producers ) } }, uniqueItems * producers, [&](){
+                contend( producers, uniqueItems,
+                    [&]( size_t p, size_t i ){ deque.push_back( p * uniqueItems + i, true ); },
+                    [&]( size_t count ){ size_t v; for( size_t n = 0; n < count; ++n ) deque.wait_and_pop_front( v ); } );
+            } );
+        }
+
+        {
+            // what request() and prefetch() push, the loader threads pop the highest priority first
+            rph::ConcurrentPriorityQueue<size_t> queue;
+            context.measure( "ConcurrentPriorityQueue push/wait_and_pop", { { "producers", double( producers ) } }, total, [&](){
+                contend( producers, perProducer,
+                    [&]( size_t p, size_t i ){ queue.push( p * perProducer + i, int( i % 16 ) ); },
+                    [&]( size_t count ){ size_t v; for( size_t n = 0; n < count; ++n ) queue.wait_and_pop( v ); } );
+            } );
+        }
+
+        {
+            // what a batched prefetch() pushes, one lock for the whole batch instead of one per item
+            rph::ConcurrentPriorityQueue<size_t> queue;
+            context.measure( "ConcurrentPriorityQueue batch push/wait_and_pop", { { "producers", double( producers ) } }, total, [&](){
+                contend( producers, 1,
+                    [&]( size_t p, size_t ){
+                        std::vector<size_t> items( perProducer );
+                        for( size_t i = 0; i < perProducer; ++i ) items[i] = p * perProducer + i;
+                        queue.push( items.begin(), items.end(), 0 );
+                    },
+                    [&]( size_t ){ size_t v; for( size_t n = 0; n < total; ++n ) queue.wait_and_pop( v ); } );
+            } );
+        }
+
+        {
+            rph::ConcurrentMap<size_t, size_t> map;
+            context.measure( "ConcurrentMap push/try_pop", { { "producers", double( producers ) } }, total, [&](){
+                contend( producers, perProducer,
+                    [&]( size_t p, size_t i ){ map.push( p * perProducer + i, i ); },
+                    [&]( size_t count ){
+                        // the main thread polls for a specific key, like fetch() does
+                        size_t v;
+                        for( size_t key = 0; key < count; ){
+                            if( map.try_pop( key, v ) ) ++key;
+                            else std::this_thread::yield();
+                        }
+                    } );
+            } );
+        }
+    }
+}
@@ -0,0 +1,85 @@
+/*
+ Decode throughput over a generated image corpus, through SurfaceStore::decode(), which is what
+ the loader threads run: read the encoded bytes, decode from the buffer, convert to a Surface.
+ Only built when the bench is configured with CINDER_PATH.
+*/
+
+#include "Bench.h"
+
+#include "rph/ImageProbe.h"
+#include "rph/SurfaceStore.h"
+
+#include "cinder/ImageIo.h"
+#include "cinder/Surface.h"
+#include "cinder/Rand.h"
+
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    //! smooth gradients with some noise on top, so the encoders don't get an unrealistically easy job
+    ci::Surface8u makeImage( int width, int height, uint32_t seed )
+    {
+        ci::Rand rnd( seed );
+        ci::Surface8u surface( width, height, false );
+        auto iter = surface.getIter();
+        while( iter.line() ){
+            while( iter.pixel() ){
+                iter.r() = uint8_t( ( iter.x() * 255 ) / width ) ^ uint8_t( rnd.nextInt( 16 ) );
+                iter.g() = uint8_t( ( iter.y() * 255 ) / height ) ^ uint8_t( rnd.nextInt( 16 ) );
+                iter.b() = uint8_t( ( ( iter.x() + iter.y() ) * 127 ) / ( width + height ) + rnd.nextInt( 32 ) );
+            }
+        }
+        return surface;
+    }
+
+} // anonymous namespace
+
+RPH_BENCH_SUITE( Decode )
+{
+    const int count = context.isQuick() ? 4 : 16;
+    const std::vector<int> sizes = context.isQuick() ? std::vector<int>{ 512 } : std::vector<int>{ 512, 2048 };
+
+    for( int size : sizes ){
+        for( std::string extension : { "jpg", "png" } ){
+            std::vector<fs::path> corpus;
+            for( int i = 0; i < count; ++i ){
+                fs::path path = fs::path( context.getTempDir() ) / ( std::to_string( size ) + "_" + std::to_string( i ) + "." + extension );
+                ci::writeImage( path.string(), makeImage( size, size, uint32_t( i ) ) );
+                corpus.push_back( path );
+            }
+
+            // nothing is stored or demoted, so every decode reads from disk
+            rph::SurfaceStoreRef store = rph::SurfaceStore::create( 1 );
+            std::vector<uint32_t> urlIds;
+            for( const fs::path &path : corpus ) urlIds.push_back( store->getUrlId( path.string() ) );
+
+            uint64_t encodedBytes = 0;
+            uint64_t decodedBytes = 0;
+            auto start = std::chrono::steady_clock::now();
+            for( uint32_t urlId : urlIds ){
+                rph::SurfaceStore::DecodedImage decoded;
+                if( !store->decode( urlId, decoded ) ) continue;
+                encodedBytes += decoded.encoded->getSize();
+                decodedBytes += uint64_t( decoded.surface->getRowBytes() ) * decoded.surface->getHeight();
+            }
+
+            bench::Result result;
+            result.name = "read + decode + convert " + extension;
+            result.params = { { "size", double( size ) }, { "images", double( count ) }, { "encodedKB", double( encodedBytes / 1024 / count ) } };
+            result.ops = uint64_t( count );
+            result.seconds = bench::secondsSince( start );
+            result.bytes = decodedBytes;
+            context.add( result );
+
+            // what probe() reads instead, to get the size for a layout
+            size_t probed = 0;
+            context.measure( "probe header " + extension, { { "size", double( size ) }, { "images", double( count ) } }, uint64_t( count ), [&](){
+                for( const fs::path &path : corpus ) probed += rph::probeImageFile( path.string() ).isValid();
+            } );
+            bench::doNotOptimize( probed );
+        }
+    }
+}
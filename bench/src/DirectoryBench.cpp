@@ -0,0 +1,83 @@
+/*
+ Directory listing and garbage collection sweeps, through the SurfaceStore itself.
+
+ The listing runs SurfaceStore::listImageDirectory(), which loadImageDirectory() and probeDirectory()
+ start with: iterate, keep regular files with an image extension, sort alphabetically. The sweep runs
+ SurfaceStore::garbageCollect() over stored surfaces, a share of them still in use by the application,
+ demoting the encoded bytes of the others to the cpu tier. Only built when the bench is configured
+ with CINDER_PATH.
+*/
+
+#include "Bench.h"
+
+#include "rph/SurfaceStore.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    //! fills the store with surfaces directly, decoding 100k images would drown out the sweep
+    class SweepStore : public rph::SurfaceStore {
+      public:
+        SweepStore() : rph::SurfaceStore( rph::DecodePool::create( 1 ) ) {}
+
+        ci::SurfaceRef add( uint32_t urlId, const ci::BufferRef &encoded ){
+            return storeSurface( urlId, DecodedImage{ ci::Surface::create( 1, 1, false ), encoded } );
+        }
+    };
+
+} // anonymous namespace
+
+RPH_BENCH_SUITE( DirectoryListing )
+{
+    std::vector<size_t> sizes = context.isQuick() ? std::vector<size_t>{ 1000 } : std::vector<size_t>{ 1000, 10000 };
+    const size_t rounds = context.isQuick() ? 5 : 20;
+    rph::SurfaceStoreRef store = rph::SurfaceStore::create( 1 );
+
+    for( size_t count : sizes ){
+        fs::path dir = fs::path( context.getTempDir() ) / std::to_string( count );
+        fs::create_directories( dir );
+
+        // mostly images, with the usual clutter in between
+        const char *extensions[] = { ".jpg", ".png", ".jpeg", ".txt", ".DS_Store" };
+        char name[64];
+        for( size_t i = 0; i < count; ++i ){
+            snprintf( name, sizeof( name ), "image_%06zu%s", ( i * 7919 ) % count, extensions[ i % 5 ] );
+            std::ofstream( dir / name ).put( 'x' );
+        }
+
+        size_t found = 0;
+        context.measure( "list + filter + sort", { { "files", double( count ) } }, count * rounds, [&](){
+            for( size_t r = 0; r < rounds; ++r ){
+                found += store->listImageDirectory( dir ).size();
+            }
+        } );
+        bench::doNotOptimize( found );
+    }
+}
+
+RPH_BENCH_SUITE( GarbageCollect )
+{
+    std::vector<size_t> sizes = context.isQuick() ? std::vector<size_t>{ 10000 } : std::vector<size_t>{ 10000, 100000 };
+    ci::BufferRef encoded = ci::Buffer::create( 64 * 1024 );
+
+    for( size_t count : sizes ){
+        for( double heldRatio : { 1.0, 0.5, 0.0 } ){
+            SweepStore store;
+            std::vector<ci::SurfaceRef> held;
+            for( size_t i = 0; i < count; ++i ){
+                ci::SurfaceRef surface = store.add( uint32_t( i ), encoded );
+                if( double( i % 100 ) < heldRatio * 100.0 ) held.push_back( surface );
+            }
+
+            context.measure( "sweep", { { "entries", double( count ) }, { "held", heldRatio } }, count, [&](){
+                store.garbageCollect();
+            } );
+            bench::doNotOptimize( store.getSurfaceRefsCount() );
+        }
+    }
+}
@@ -0,0 +1,89 @@
+/*
+ Header probing over a directory of generated files.
+
+ The files carry a real JPEG or PNG header in front of filler bytes, with an EXIF sized segment
+ ahead of the JPEG frame header, which is what probe() skips over on camera images. Compares
+ probing the header against reading the whole file, the least a decode has to do.
+*/
+
+#include "Bench.h"
+
+#include "rph/ImageProbe.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+    void putBigEndian( std::ofstream &os, uint32_t value, int bytes )
+    {
+        for( int i = bytes - 1; i >= 0; --i ) os.put( char( ( value >> ( i * 8 ) ) & 0xFF ) );
+    }
+
+    void writeJpeg( const fs::path &path, uint32_t width, uint32_t height, size_t fileBytes )
+    {
+        std::ofstream os( path, std::ios::binary );
+        os.put( char( 0xFF ) ); os.put( char( 0xD8 ) );
+        // APP1 with 32 kB of metadata
+        os.put( char( 0xFF ) ); os.put( char( 0xE1 ) ); putBigEndian( os, 32 * 1024 + 2, 2 );
+        os << std::string( 32 * 1024, '\0' );
+        // SOF0: length, precision, height, width, components
+        os.put( char( 0xFF ) ); os.put( char( 0xC0 ) ); putBigEndian( os, 17, 2 );
+        os.put( 8 ); putBigEndian( os, height, 2 ); putBigEndian( os, width, 2 ); os.put( 3 );
+        os << std::string( 9, '\0' );
+        os << std::string( fileBytes, 'x' );
+    }
+
+    void writePng( const fs::path &path, uint32_t width, uint32_t height, size_t fileBytes )
+    {
+        std::ofstream os( path, std::ios::binary );
+        const char signature[8] = { char( 0x89 ), 'P', 'N', 'G', '\r', '\n', char( 0x1A ), '\n' };
+        os.write( signature, 8 );
+        putBigEndian( os, 13, 4 ); os << "IHDR";
+        putBigEndian( os, width, 4 ); putBigEndian( os, height, 4 );
+        os.put( 8 ); os.put( 6 ); os.put( 0 ); os.put( 0 ); os.put( 0 );
+        putBigEndian( os, 0, 4 ); // crc, not checked
+        os << std::string( fileBytes, 'x' );
+    }
+
+} // anonymous namespace
+
+RPH_BENCH_SUITE( Probe )
+{
+    const size_t count = context.isQuick() ? 100 : 1000;
+    const size_t fileBytes = context.isQuick() ? 256 * 1024 : 1024 * 1024;
+
+    fs::path dir = fs::path( context.getTempDir() ) / "probe";
+    fs::create_directories( dir );
+    std::vector<fs::path> files;
+    char name[64];
+    for( size_t i = 0; i < count; ++i ){
+        bool jpeg = i % 2 == 0;
+        snprintf( name, sizeof( name ), "image_%06zu.%s", i, jpeg ? "jpg" : "png" );
+        files.push_back( dir / name );
+        if( jpeg ) writeJpeg( files.back(), 4000, 3000, fileBytes );
+        else writePng( files.back(), 4000, 3000, fileBytes );
+    }
+
+    size_t valid = 0;
+    context.measure( "probe header", { { "files", double( count ) }, { "fileKB", double( fileBytes / 1024 ) } }, count, [&](){
+        for( const fs::path &path : files ) valid += rph::probeImageFile( path.string() ).isValid();
+    } );
+
+    size_t bytes = 0;
+    context.measure( "read whole file", { { "files", double( count ) }, { "fileKB", double( fileBytes / 1024 ) } }, count, [&](){
+        std::vector<char> buffer;
+        for( const fs::path &path : files ){
+            std::ifstream is( path, std::ios::binary );
+            buffer.assign( std::istreambuf_iterator<char>( is ), std::istreambuf_iterator<char>() );
+            bytes += buffer.size();
+        }
+    } );
+
+    if( valid != count ) fprintf( stderr, "Probe: only %zu of %zu headers were read\n", valid, count );
+    bench::doNotOptimize( valid );
+    bench::doNotOptimize( bytes );
+}
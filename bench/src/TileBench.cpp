@@ -0,0 +1,92 @@
+/*
+ Viewport queries on a gigapixel tile grid.
+
+ Pans and zooms a viewport across the grid the way fetchTiles() gets called every frame, and keeps
+ the tiles in a byte budgeted LruCache to show that memory follows the viewport, not the image.
+ The last run picks the tiles to draw with TileGrid::getDrawTiles() while only a few tiles load per
+ frame, and checks that every tile in view is drawn or has a stand-in.
+*/
+
+#include "Bench.h"
+
+#include "rph/LruCache.h"
+#include "rph/TileGrid.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+
+RPH_BENCH_SUITE( Tiles )
+{
+    const size_t frames = context.isQuick() ? 20000 : 200000;
+    const int32_t tileSize = 512;
+    const size_t tileBytes = size_t( tileSize ) * tileSize * 4;
+    rph::TileGrid grid( 64000, 32000, tileSize ); // 2 gigapixels
+
+    // a 1920x1080 viewport stepping across the image at random zoom levels
+    std::vector<std::pair<rph::PixelRect, float>> views;
+    std::mt19937 rnd( 42 );
+    std::uniform_real_distribution<float> zoom( 0.05f, 1.5f );
+    for( size_t i = 0; i < 1024; ++i ){
+        float scale = zoom( rnd );
+        int32_t width = int32_t( 1920 / scale ), height = int32_t( 1080 / scale );
+        int32_t x = int32_t( ( i * 997 ) % size_t( std::max( 1, grid.getWidth() - width ) ) );
+        int32_t y = int32_t( ( i * 331 ) % size_t( std::max( 1, grid.getHeight() - height ) ) );
+        views.push_back( std::make_pair( rph::PixelRect( x, y, x + width, y + height ), scale ) );
+    }
+
+    size_t tiles = 0;
+    context.measure( "tiles for viewport", { { "levels", double( grid.getLevelCount() ) }, { "tiles", double( grid.getTileCount() ) } }, frames, [&](){
+        for( size_t i = 0; i < frames; ++i ){
+            const auto &view = views[ i % views.size() ];
+            tiles += grid.getTilesForScale( view.first, view.second ).size();
+        }
+    } );
+
+    // twice what a 1080p viewport needs at its worst
+    rph::LruCache<uint64_t, std::shared_ptr<int>> cache( tileBytes * 2 * ( ( 1920 / tileSize + 2 ) * ( 1080 / tileSize + 2 ) ) * 2 );
+    std::shared_ptr<int> tile = std::make_shared<int>( 0 );
+    context.measure( "tiles for viewport + cache", { { "budgetMB", double( cache.getBudget() >> 20 ) } }, frames, [&](){
+        std::shared_ptr<int> found;
+        for( size_t i = 0; i < frames; ++i ){
+            const auto &view = views[ i % views.size() ];
+            for( const rph::TileId &id : grid.getTilesForScale( view.first, view.second ) ){
+                if( !cache.get( id.pack(), found ) ) cache.put( id.pack(), tile, tileBytes );
+            }
+        }
+    } );
+
+    rph::CacheStats stats = cache.getStats();
+    fprintf( stderr, "Tiles: %zu tiles per view on average, cache hit ratio %.2f, %zu MB resident\n", tiles / frames, stats.getHitRatio(), cache.getBytes() >> 20 );
+    bench::doNotOptimize( tiles );
+
+    // only the coarsest tile is there from the start, the rest load a few per frame like uploads do
+    const size_t loadsPerFrame = 4;
+    rph::LruCache<uint64_t, std::shared_ptr<int>> loaded( cache.getBudget() );
+    const rph::TileId top( uint32_t( grid.getLevelCount() - 1 ), 0, 0 );
+    size_t drawn = 0, missing = 0, uncovered = 0;
+    context.measure( "draw tiles with stand-ins", { { "loadsPerFrame", double( loadsPerFrame ) } }, frames, [&](){
+        auto isLoaded = [&]( const rph::TileId &id ){ return id == top || loaded.contains( id.pack() ); };
+        for( size_t i = 0; i < frames; ++i ){
+            // a few frames at every view, so its tiles have a chance to load
+            const auto &view = views[ ( i / 8 ) % views.size() ];
+            std::vector<rph::TileId> visible = grid.getTilesForScale( view.first, view.second );
+            std::vector<rph::TileId> draw = grid.getDrawTiles( visible, isLoaded );
+            drawn += draw.size();
+
+            size_t loads = 0;
+            for( const rph::TileId &id : visible ){
+                if( isLoaded( id ) ) continue;
+                missing++;
+                // every missing tile has to be under one that is drawn
+                bool covered = false;
+                for( rph::TileId parent = id.getParent(); !covered && int32_t( parent.level ) < grid.getLevelCount(); parent = parent.getParent() ){
+                    covered = std::find( draw.begin(), draw.end(), parent ) != draw.end();
+                }
+                if( !covered ) uncovered++;
+                if( loads++ < loadsPerFrame ) loaded.put( id.pack(), tile, tileBytes );
+            }
+        }
+    } );
+    fprintf( stderr, "Tiles: %zu tiles drawn per frame on average, %zu missing tiles stood in for, %zu left uncovered\n", drawn / frames, missing, uncovered );
+}
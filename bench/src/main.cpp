@@ -0,0 +1,154 @@
+/*
+ TextureStoreBench
+
+ usage: TextureStoreBench [--quick] [--filter <suite>] [--out <results.json>] [--temp <dir>]
+
+ generated files go to a TextureStoreBench folder inside the temp directory, which is removed afterwards.
+*/
+
+#include "Bench.h"
+
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace bench {
+
+    std::vector<Suite>& getSuites()
+    {
+        static std::vector<Suite> suites;
+        return suites;
+    }
+
+    std::string Context::getTempDir() const
+    {
+        fs::path dir = fs::path( mOptions.tempDir ) / mSuite;
+        fs::create_directories( dir );
+        return dir.string();
+    }
+
+    Result& Context::measure( const std::string &name, const Params &params, uint64_t ops, const std::function<void()> &fn )
+    {
+        Result result;
+        result.name = name;
+        result.params = params;
+        result.ops = ops;
+
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        result.seconds = secondsSince( start );
+
+        return add( result );
+    }
+
+    Result& Context::add( const Result &result )
+    {
+        mResults.push_back( result );
+        mResults.back().suite = mSuite;
+
+        const Result &r = mResults.back();
+        std::string params;
+        for( auto &p : r.params ){
+            char buf[64];
+            snprintf( buf, sizeof( buf ), " %s=%g", p.first.c_str(), p.second );
+            params += buf;
+        }
+        printf( "%-22s %-36s%-28s %12.1f ns/op %14.0f op/s", r.suite.c_str(), r.name.c_str(), params.c_str(), r.getNanosPerOp(), r.getOpsPerSecond() );
+        if( r.bytes > 0 )
+            printf( " %10.1f MB/s", r.getBytesPerSecond() / ( 1024.0 * 1024.0 ) );
+        printf( "\n" );
+        fflush( stdout );
+
+        return mResults.back();
+    }
+
+} // namespace bench
+
+namespace {
+
+    void writeJsonString( std::ostream &os, const std::string &str )
+    {
+        os << '"';
+        for( char c : str ){
+            if( c == '"' || c == '\\' ) os << '\\';
+            os << c;
+        }
+        os << '"';
+    }
+
+    bool writeJson( const std::string &path, const std::vector<bench::Result> &results, const bench::Options &options )
+    {
+        std::ofstream os( path );
+        if( !os.is_open() ) return false;
+
+        os << "{\n  \"timestamp\": " << std::time( nullptr )
+           << ",\n  \"hardwareConcurrency\": " << std::thread::hardware_concurrency()
+           << ",\n  \"quick\": " << ( options.quick ? "true" : "false" )
+           << ",\n  \"results\": [";
+        for( size_t i = 0; i < results.size(); ++i ){
+            const bench::Result &r = results[i];
+            os << ( i > 0 ? ",\n    {" : "\n    {" ) << "\"suite\": ";
+            writeJsonString( os, r.suite );
+            os << ", \"name\": ";
+            writeJsonString( os, r.name );
+            os << ", \"params\": {";
+            for( size_t p = 0; p < r.params.size(); ++p ){
+                if( p > 0 ) os << ", ";
+                writeJsonString( os, r.params[p].first );
+                os << ": " << r.params[p].second;
+            }
+            os << "}, \"ops\": " << r.ops << ", \"seconds\": " << r.seconds
+               << ", \"nsPerOp\": " << r.getNanosPerOp() << ", \"opsPerSecond\": " << r.getOpsPerSecond();
+            if( r.bytes > 0 )
+                os << ", \"bytes\": " << r.bytes << ", \"bytesPerSecond\": " << r.getBytesPerSecond();
+            os << "}";
+        }
+        os << "\n  ]\n}\n";
+        return os.good();
+    }
+
+} // anonymous namespace
+
+int main( int argc, char *argv[] )
+{
+    bench::Options options;
+    fs::path tempParent = fs::temp_directory_path();
+    std::string filter;
+    std::string out;
+
+    for( int i = 1; i < argc; ++i ){
+        if( strcmp( argv[i], "--quick" ) == 0 ) options.quick = true;
+        else if( strcmp( argv[i], "--filter" ) == 0 && i + 1 < argc ) filter = argv[++i];
+        else if( strcmp( argv[i], "--out" ) == 0 && i + 1 < argc ) out = argv[++i];
+        else if( strcmp( argv[i], "--temp" ) == 0 && i + 1 < argc ) tempParent = argv[++i];
+        else {
+            printf( "usage: %s [--quick] [--filter <suite>] [--out <results.json>] [--temp <dir>]\n", argv[0] );
+            return 1;
+        }
+    }
+
+    options.tempDir = ( tempParent / "TextureStoreBench" ).string();
+
+    std::vector<bench::Result> results;
+    for( const bench::Suite &suite : bench::getSuites() ){
+        if( !filter.empty() && std::string( suite.name ).find( filter ) == std::string::npos )
+            continue;
+
+        bench::Context context( suite.name, options, results );
+        suite.fn( context );
+    }
+
+    std::error_code ec;
+    fs::remove_all( options.tempDir, ec );
+
+    if( !out.empty() && !writeJson( out, results, options ) ){
+        printf( "could not write results to %s\n", out.c_str() );
+        return 1;
+    }
+    return 0;
+}
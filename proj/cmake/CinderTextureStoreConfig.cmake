@@ -5,9 +5,29 @@ if( NOT TARGET CinderTextureStore )
 	list( APPEND CinderTextureStore_SRCS
 		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/TextureStore.h
 		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/TextureStore.cpp
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/AccessManifest.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/AccessManifest.cpp
 		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/ConcurrentDeque.h
 		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/ConcurrentMap.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/ConcurrentPriorityQueue.h
 		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/ConcurrentQueue.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/DecodePool.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/DecodePool.cpp
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/DirectoryWatcher.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/DirectoryWatcher.cpp
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/ImageProbe.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/ImageProbe.cpp
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/KeyRegistry.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/LoadBatch.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/LoadStats.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/LoadStats.cpp
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/LoadThrottle.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/LruCache.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/TileGrid.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/TilePyramid.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/TilePyramid.cpp
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/SurfaceStore.h
+		${CINDER_TEXTURE_STORE_SOURCE_PATH}/rph/SurfaceStore.cpp
 	)
 	if(MSVC)
 		foreach(source ${CinderTextureStore_SRCS})
@@ -0,0 +1,144 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "rph/AccessManifest.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace rph {
+
+    namespace {
+        const char *MANIFEST_HEADER = "# rph::AccessManifest 1";
+
+        uint64_t nowMicros(){
+            return uint64_t( std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count() );
+        }
+    } // anonymous namespace
+
+    AccessManifest::AccessManifest()
+    : mRecording( false ), mStartMicros( 0 )
+    {
+    }
+
+    void AccessManifest::setRecording( bool recording ){
+        std::unique_lock<std::mutex> lock( mMutex );
+        // access times count from the first time recording is switched on
+        if( recording && mRecords.empty() ) mStartMicros = nowMicros();
+        mRecording = recording;
+    }
+
+    void AccessManifest::add( uint32_t urlId ){
+        std::unique_lock<std::mutex> lock( mMutex );
+        auto itr = mRecords.find( urlId );
+        if( itr != mRecords.end() ){
+            itr->second.count++;
+            return;
+        }
+        mRecords[ urlId ] = Record{ double( nowMicros() - mStartMicros ) / 1000000.0, 1 };
+    }
+
+    void AccessManifest::clear(){
+        std::unique_lock<std::mutex> lock( mMutex );
+        mRecords.clear();
+        mStartMicros = nowMicros();
+    }
+
+    size_t AccessManifest::size() const {
+        std::unique_lock<std::mutex> lock( mMutex );
+        return mRecords.size();
+    }
+
+    std::vector<AccessManifest::Entry> AccessManifest::getEntries( const KeyRegistry &keys ) const {
+        std::vector<Entry> entries;
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            entries.reserve( mRecords.size() );
+            for( auto &record : mRecords ){
+                Entry entry;
+                entry.url = keys.getUrl( record.first );
+                entry.firstAccess = record.second.firstAccess;
+                entry.count = record.second.count;
+                entries.push_back( entry );
+            }
+        }
+        sortForPrefetch( entries );
+        return entries;
+    }
+
+    void AccessManifest::sortForPrefetch( std::vector<Entry> &entries ){
+        std::stable_sort( entries.begin(), entries.end(), []( const Entry &a, const Entry &b ){
+            double secondA = std::floor( a.firstAccess );
+            double secondB = std::floor( b.firstAccess );
+            if( secondA != secondB ) return secondA < secondB;
+            if( a.count != b.count ) return a.count > b.count;
+            return a.firstAccess < b.firstAccess;
+        } );
+    }
+
+    void AccessManifest::write( std::ostream &os, const KeyRegistry &keys ) const {
+        // one line per image: first access, count and the url, which goes last as it may contain spaces
+        os << MANIFEST_HEADER << "\n";
+        for( const Entry &entry : getEntries( keys ) ){
+            if( entry.url.empty() ) continue;
+            os << entry.firstAccess << "\t" << entry.count << "\t" << entry.url << "\n";
+        }
+    }
+
+    bool AccessManifest::save( const std::string &path, const KeyRegistry &keys ) const {
+        std::ofstream file( path.c_str() );
+        if( !file.is_open() ) return false;
+
+        write( file, keys );
+        return file.good();
+    }
+
+    std::vector<AccessManifest::Entry> AccessManifest::read( std::istream &is ){
+        std::vector<Entry> entries;
+        std::string line;
+        if( !std::getline( is, line ) || line != MANIFEST_HEADER ) return entries;
+
+        while( std::getline( is, line ) ){
+            std::istringstream fields( line );
+            Entry entry;
+            if( !( fields >> entry.firstAccess >> entry.count ) ) continue;
+            fields.get(); // tab in front of the url
+            std::getline( fields, entry.url );
+            if( !entry.url.empty() ) entries.push_back( entry );
+        }
+        sortForPrefetch( entries );
+        return entries;
+    }
+
+    std::vector<AccessManifest::Entry> AccessManifest::load( const std::string &path ){
+        std::ifstream file( path.c_str() );
+        if( !file.is_open() ) return std::vector<Entry>();
+
+        return read( file );
+    }
+
+} // namespace rph
@@ -0,0 +1,87 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "rph/KeyRegistry.h"
+
+namespace rph {
+
+    //! records which images get asked for, when first and how often, so the next launch can
+    //! prefetch the working set in the order it is going to be needed
+    class AccessManifest {
+      public:
+        struct Entry {
+            std::string url;
+            //! seconds between the start of the recording and the first request
+            double      firstAccess = 0.0;
+            //! number of load()/fetch() calls, including the ones served from the cache
+            uint32_t    count = 0;
+        };
+
+        AccessManifest();
+
+        //! starts or stops recording, starting again keeps the accesses recorded so far
+        void    setRecording( bool recording );
+        bool    isRecording() const { return mRecording; }
+        //! called on every load()/fetch(), costs a single atomic read when not recording
+        void    record( uint32_t urlId ){ if( mRecording ) add( urlId ); }
+        void    clear();
+        size_t  size() const;
+
+        //! the recorded accesses in prefetch order, with their urls looked up in the registry
+        std::vector<Entry>  getEntries( const KeyRegistry &keys ) const;
+
+        void    write( std::ostream &os, const KeyRegistry &keys ) const;
+        bool    save( const std::string &path, const KeyRegistry &keys ) const;
+        //! reads a manifest in prefetch order, returns nothing if the file doesn't exist or isn't a manifest
+        static std::vector<Entry>   read( std::istream &is );
+        static std::vector<Entry>   load( const std::string &path );
+
+        //! earliest first at a resolution of a second, the most requested first within the same second
+        static void sortForPrefetch( std::vector<Entry> &entries );
+
+      private:
+        struct Record {
+            double      firstAccess;
+            uint32_t    count;
+        };
+
+        void add( uint32_t urlId );
+
+        std::atomic<bool>                       mRecording;
+        uint64_t                                mStartMicros;
+        std::unordered_map<uint32_t, Record>    mRecords;
+        mutable std::mutex                      mMutex;
+    };
+
+} // namespace rph
@@ -25,7 +25,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <condition_variable>
 #include <deque>
+#include <mutex>
 
 namespace rph {
 
@@ -101,6 +104,12 @@ public:
 		return false;
     }
 
+    int size() const
+    {
+        std::unique_lock<std::mutex> lock( mMutex );
+        return (int)mDeque.size();
+    }
+
     bool empty() const
     {
         std::unique_lock<std::mutex> lock( mMutex );
@@ -133,7 +142,7 @@ public:
     }
 private:
     std::deque<Data>			mDeque;
-    std::mutex                  mMutex;
+    mutable std::mutex          mMutex;
     std::condition_variable     mCondition;
 };
 
@@ -25,7 +25,9 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <map>
+#include <mutex>
 
 namespace rph {
 
@@ -111,7 +113,7 @@ public:
     }
 private:
     std::map<Key, Data>			mQueue;
-    std::mutex                  mMutex;
+    mutable std::mutex          mMutex;
     std::condition_variable     mCondition;
     
 };
@@ -0,0 +1,171 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace rph {
+
+//! a queue of unique items that pops the highest priority first, and items of equal priority
+//! in the order they were pushed. Pushing an item that is already queued raises its priority.
+template<typename Data, typename Hash = std::hash<Data>>
+class ConcurrentPriorityQueue
+{
+public:
+	ConcurrentPriorityQueue(void) : mSequence(0) {};
+	~ConcurrentPriorityQueue(void){};
+
+	void clear()
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		mQueue.clear();
+		mItems.clear();
+	}
+
+	bool contains(Data const& data) const
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		return mItems.find(data) != mItems.end();
+	}
+
+	bool erase(Data const& data)
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+
+		typename ItemMap::iterator itr = mItems.find(data);
+		if(itr == mItems.end())
+			return false;
+
+		mQueue.erase(itr->second);
+		mItems.erase(itr);
+		return true;
+	}
+
+	//! returns true if the item was added, false if it was queued already
+	bool push(Data const& data, int priority)
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		if(!pushLocked(data, priority))
+			return false;
+
+		lock.unlock();
+		mCondition.notify_one();
+
+		return true;
+	}
+
+	//! pushes a range of items in order under a single lock, returns the number of items added
+	template<typename Iterator>
+	int push(Iterator begin, Iterator end, int priority)
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		int added = 0;
+		for(Iterator itr = begin; itr != end; ++itr) {
+			if(pushLocked(*itr, priority)) added++;
+		}
+		lock.unlock();
+		mCondition.notify_all();
+
+		return added;
+	}
+
+	int size() const
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		return (int)mQueue.size();
+	}
+
+	bool empty() const
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		return mQueue.empty();
+	}
+
+	bool try_pop(Data& popped_value, int *priority = nullptr)
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		if(mQueue.empty())
+			return false;
+
+		popFrontLocked(popped_value, priority);
+		return true;
+	}
+
+	void wait_and_pop(Data& popped_value, int *priority = nullptr)
+	{
+		std::unique_lock<std::mutex> lock( mMutex );
+		while(mQueue.empty())
+		{
+			mCondition.wait(lock);
+		}
+
+		popFrontLocked(popped_value, priority);
+	}
+
+private:
+	//! negated priority first so the highest priority sorts to the front, then the push order
+	typedef std::pair<int, uint64_t>							Order;
+	typedef std::map<Order, Data>								QueueMap;
+	typedef std::unordered_map<Data, typename QueueMap::iterator, Hash>	ItemMap;
+
+	bool pushLocked(Data const& data, int priority)
+	{
+		typename ItemMap::iterator itr = mItems.find(data);
+		if(itr != mItems.end()) {
+			// keep the place in line unless the new priority is higher
+			if(-itr->second->first.first < priority) {
+				mQueue.erase(itr->second);
+				itr->second = mQueue.insert(std::make_pair(Order(-priority, mSequence++), data)).first;
+			}
+			return false;
+		}
+
+		mItems[data] = mQueue.insert(std::make_pair(Order(-priority, mSequence++), data)).first;
+		return true;
+	}
+
+	void popFrontLocked(Data& popped_value, int *priority)
+	{
+		typename QueueMap::iterator front = mQueue.begin();
+		popped_value = front->second;
+		if(priority) *priority = -front->first.first;
+		mItems.erase(front->second);
+		mQueue.erase(front);
+	}
+
+	QueueMap					mQueue;
+	ItemMap						mItems;
+	uint64_t					mSequence;
+	mutable std::mutex			mMutex;
+	std::condition_variable		mCondition;
+};
+
+} // namespace rph
@@ -25,7 +25,9 @@
 
 #pragma once
 
+#include <condition_variable>
 #include <queue>
+#include <mutex>
 
 namespace rph {
 
@@ -69,7 +71,7 @@ public:
     }
 private:
     std::queue<Data>			mQueue;
-    std::mutex                  mMutex;
+    mutable std::mutex          mMutex;
     std::condition_variable     mCondition;
 };
 
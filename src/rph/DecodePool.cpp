@@ -0,0 +1,141 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+
+#include "rph/DecodePool.h"
+
+#include "cinder/Log.h"
+#include "cinder/Thread.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace rph {
+
+    DecodePoolRef DecodePool::getDefault(){
+        static std::mutex mutex;
+        static DecodePoolRef pool;
+        std::unique_lock<std::mutex> lock( mutex );
+        if( !pool ) pool = create( std::max( 1, int( std::thread::hardware_concurrency() / 2 ) ) );
+        return pool;
+    }
+
+    DecodePool::DecodePool( int numThreads )
+    : mNext( 0 ), mShouldQuit( false )
+    {
+        // create and launch the threads
+        for( int i = 0; i < std::max( 1, numThreads ); ++i ){
+            mThreads.push_back( std::shared_ptr<std::thread>( new std::thread( std::bind( &DecodePool::threadFn, this ) ) ) );
+        }
+    }
+
+    DecodePool::~DecodePool(){
+        // stop threads, waking up the ones waiting for work
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            mShouldQuit = true;
+        }
+        mCondition.notify_all();
+        for( auto &thread : mThreads ){
+            try{
+                thread->join();
+            }catch(...){}
+        }
+    }
+
+    void DecodePool::addClient( Client *client ){
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            mClients.push_back( Entry{ client, 0, false } );
+        }
+        mCondition.notify_all();
+    }
+
+    void DecodePool::removeClient( Client *client ){
+        std::unique_lock<std::mutex> lock( mMutex );
+        Entry *entry = findClient( client );
+        if( !entry ) return;
+        entry->removing = true;
+        mRemoveCondition.wait( lock, [&](){ return findClient( client )->running == 0; } );
+
+        auto itr = std::find_if( mClients.begin(), mClients.end(), [&]( const Entry &e ){ return e.client == client; } );
+        if( size_t( itr - mClients.begin() ) < mNext ) mNext--;
+        mClients.erase( itr );
+    }
+
+    void DecodePool::notify(){
+        // taking the lock makes sure no thread is between checking for work and going to sleep
+        std::unique_lock<std::mutex> lock( mMutex );
+        lock.unlock();
+        mCondition.notify_all();
+    }
+
+    DecodePool::Entry* DecodePool::findClient( Client *client ){
+        for( Entry &entry : mClients ){
+            if( entry.client == client ) return &entry;
+        }
+        return NULL;
+    }
+
+    DecodePool::Entry* DecodePool::nextClient(){
+        const size_t count = mClients.size();
+        for( size_t i = 0; i < count; ++i ){
+            const size_t index = ( mNext + i ) % count;
+            Entry &entry = mClients[index];
+            if( !entry.removing && entry.client->hasJob() ){
+                mNext = index + 1;
+                return &entry;
+            }
+        }
+        return NULL;
+    }
+
+    void DecodePool::threadFn(){
+        ci::ThreadSetup threadSetup; // instantiate this if you're talking to Cinder from a secondary thread
+
+        CI_LOG_I( "DECODEPOOL THREAD STARTED" );
+        std::unique_lock<std::mutex> lock( mMutex );
+        // run until interrupted
+        while( !mShouldQuit ){
+            Entry *entry = nextClient();
+            if( !entry ){
+                mCondition.wait( lock );
+                continue;
+            }
+
+            // run the job unlocked, the entry may move while other clients come and go
+            Client *client = entry->client;
+            entry->running++;
+            lock.unlock();
+            client->runJob();
+            lock.lock();
+
+            entry = findClient( client );
+            entry->running--;
+            if( entry->removing ) mRemoveCondition.notify_all();
+        }
+        CI_LOG_I( "DECODEPOOL THREAD STOPPED" );
+    }
+
+} // namespace rph
@@ -0,0 +1,94 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace rph {
+
+    typedef std::shared_ptr<class DecodePool> DecodePoolRef;
+
+    //! worker threads shared by any number of stores, so every store that wants its own cache and budget
+    //! doesn't have to bring its own threads. Stores with work get a turn in round robin, so one with a long
+    //! queue can't starve the others, and each store still orders its own jobs and limits how many run at once.
+    class DecodePool {
+      public:
+        //! something that hands jobs to the pool, e.g. a SurfaceStore
+        class Client {
+          public:
+            virtual ~Client() {}
+            //! returns true if there is a job the client may start right now. Called with the pool locked,
+            //! so keep it quick and never call back into the pool from it.
+            virtual bool hasJob() = 0;
+            //! takes the next job and runs it on the calling pool thread, returns false if there was none after all
+            virtual bool runJob() = 0;
+        };
+
+        static DecodePoolRef create( int numThreads ) { return DecodePoolRef( new DecodePool( numThreads ) ); }
+        //! the pool of all stores that don't bring their own, created on first use with half the hardware threads
+        static DecodePoolRef getDefault();
+        ~DecodePool();
+
+        int     getThreadCount() const { return int( mThreads.size() ); }
+
+        void    addClient( Client *client );
+        //! waits for the jobs of a client that are still running, it won't get any new ones
+        void    removeClient( Client *client );
+        //! wakes up the threads after a client got new work or may start more of it.
+        //! Don't call it while holding a lock that hasJob() takes.
+        void    notify();
+
+      protected:
+        DecodePool( int numThreads );
+        DecodePool( DecodePool const& );
+        DecodePool& operator=( DecodePool const& );
+
+        struct Entry {
+            Client* client;
+            int     running;
+            bool    removing;
+        };
+
+        void    threadFn();
+        //! the next client with work after the last one that got a turn, or NULL. Call with mMutex locked.
+        Entry*  nextClient();
+        Entry*  findClient( Client *client );
+
+        std::vector<Entry>                          mClients;
+        size_t                                      mNext;
+        bool                                        mShouldQuit;
+        std::mutex                                  mMutex;
+        std::condition_variable                     mCondition;
+        //! signalled when a job of a client that is being removed finishes
+        std::condition_variable                     mRemoveCondition;
+        std::vector<std::shared_ptr<std::thread>>   mThreads;
+    };
+
+} // namespace rph
@@ -0,0 +1,253 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+
+#include "rph/DirectoryWatcher.h"
+
+#include "cinder/Log.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <set>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#if defined( __linux__ )
+    #include <poll.h>
+    #include <sys/inotify.h>
+    #include <unistd.h>
+#endif
+
+namespace rph {
+
+    DirectoryWatcher::DirectoryWatcher( double pollInterval )
+    : mPollInterval( pollInterval ), mShouldQuit( false ), mNotifyFd( -1 )
+    {
+        mWakeFds[0] = mWakeFds[1] = -1;
+#if defined( __linux__ )
+        mNotifyFd = inotify_init1( IN_NONBLOCK | IN_CLOEXEC );
+        if( mNotifyFd >= 0 && pipe( mWakeFds ) != 0 ){
+            close( mNotifyFd );
+            mNotifyFd = -1;
+        }
+        if( mNotifyFd < 0 ) CI_LOG_W( "rph::DirectoryWatcher - inotify is not available, polling instead" );
+#endif
+        mThread = std::shared_ptr<std::thread>( new std::thread( std::bind( &DirectoryWatcher::threadFn, this ) ) );
+    }
+
+    DirectoryWatcher::~DirectoryWatcher(){
+        // stop the thread, whether it waits for events or for the next poll
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            mShouldQuit = true;
+        }
+        mCondition.notify_all();
+#if defined( __linux__ )
+        if( mWakeFds[1] >= 0 ){
+            char wake = 0;
+            ssize_t written = write( mWakeFds[1], &wake, 1 );
+            (void)written;
+        }
+#endif
+        try{
+            mThread->join();
+        }catch(...){}
+#if defined( __linux__ )
+        if( mNotifyFd >= 0 ) close( mNotifyFd );
+        if( mWakeFds[0] >= 0 ) close( mWakeFds[0] );
+        if( mWakeFds[1] >= 0 ) close( mWakeFds[1] );
+#endif
+    }
+
+    void DirectoryWatcher::watch( const ci::fs::path &dir ){
+        // called whenever a directory is listed, often every frame, so only new directories get scanned
+        const std::string key = dir.string();
+        if( isWatching( dir ) ) return;
+
+        // take the baseline without the lock, a large directory takes a while
+        Snapshot files = scan( dir );
+
+        std::unique_lock<std::mutex> lock( mMutex );
+        if( mDirectories.find( key ) != mDirectories.end() ) return;
+
+        Directory directory;
+        directory.path = dir;
+        directory.watch = -1;
+        directory.files.swap( files );
+#if defined( __linux__ )
+        // a directory that can't be watched, e.g. when the user's watches run out, is polled instead
+        if( mNotifyFd >= 0 ) directory.watch = inotify_add_watch( mNotifyFd, key.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF );
+#endif
+        mDirectories[key] = directory;
+    }
+
+    void DirectoryWatcher::unwatch( const ci::fs::path &dir ){
+        std::unique_lock<std::mutex> lock( mMutex );
+        auto itr = mDirectories.find( dir.string() );
+        if( itr == mDirectories.end() ) return;
+#if defined( __linux__ )
+        if( itr->second.watch >= 0 ) inotify_rm_watch( mNotifyFd, itr->second.watch );
+#endif
+        mDirectories.erase( itr );
+    }
+
+    bool DirectoryWatcher::isWatching( const ci::fs::path &dir ){
+        std::unique_lock<std::mutex> lock( mMutex );
+        return mDirectories.find( dir.string() ) != mDirectories.end();
+    }
+
+    void DirectoryWatcher::setPollInterval( double seconds ){
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            mPollInterval = seconds;
+        }
+        mCondition.notify_all();
+    }
+
+    std::vector<DirectoryWatcher::Change> DirectoryWatcher::takeChanges(){
+        std::vector<Change> changes;
+        std::unique_lock<std::mutex> lock( mMutex );
+        changes.swap( mChanges );
+        return changes;
+    }
+
+    DirectoryWatcher::Snapshot DirectoryWatcher::scan( const ci::fs::path &dir ){
+        Snapshot files;
+        try {
+            for( ci::fs::directory_iterator it( dir ); it != ci::fs::directory_iterator(); ++it ){
+                const std::string path = it->path().string();
+                FileState state;
+#if defined( _WIN32 )
+                struct _stat64 info;
+                if( _stat64( path.c_str(), &info ) != 0 || !( info.st_mode & _S_IFREG ) ) continue;
+                state.modified = int64_t( info.st_mtime ) * 1000000000;
+#else
+                struct stat info;
+                if( stat( path.c_str(), &info ) != 0 || !S_ISREG( info.st_mode ) ) continue;
+    #if defined( __APPLE__ )
+                state.modified = int64_t( info.st_mtimespec.tv_sec ) * 1000000000 + info.st_mtimespec.tv_nsec;
+    #else
+                state.modified = int64_t( info.st_mtim.tv_sec ) * 1000000000 + info.st_mtim.tv_nsec;
+    #endif
+#endif
+                state.size = uint64_t( info.st_size );
+                files[path] = state;
+            }
+        } catch( ... ) {
+            // a directory that is gone has no files, they all get reported as removed
+        }
+        return files;
+    }
+
+    void DirectoryWatcher::rescan( const std::string &key ){
+        ci::fs::path dir;
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            auto itr = mDirectories.find( key );
+            if( itr == mDirectories.end() ) return;
+            dir = itr->second.path;
+        }
+        Snapshot files = scan( dir );
+
+        std::unique_lock<std::mutex> lock( mMutex );
+        auto itr = mDirectories.find( key );
+        if( itr == mDirectories.end() ) return;
+
+        Snapshot &previous = itr->second.files;
+        for( auto &file : files ){
+            auto before = previous.find( file.first );
+            if( before == previous.end() ) mChanges.push_back( Change{ Change::ADDED, file.first } );
+            else if( before->second != file.second ) mChanges.push_back( Change{ Change::MODIFIED, file.first } );
+        }
+        for( auto &file : previous ){
+            if( files.find( file.first ) == files.end() ) mChanges.push_back( Change{ Change::REMOVED, file.first } );
+        }
+        previous.swap( files );
+    }
+
+    std::vector<std::string> DirectoryWatcher::waitForEvents(){
+        std::set<std::string> dirs;
+#if defined( __linux__ )
+        int timeout;
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            timeout = int( mPollInterval * 1000.0 );
+        }
+        pollfd fds[2] = { { mNotifyFd, POLLIN, 0 }, { mWakeFds[0], POLLIN, 0 } };
+        int ready = poll( fds, 2, timeout );
+        if( fds[1].revents & POLLIN ) return std::vector<std::string>();
+
+        std::vector<int> watches;
+        bool overflow = false;
+        if( ready > 0 && ( fds[0].revents & POLLIN ) ){
+            // give the writer a moment to finish, a save usually comes as a burst of events
+            std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+
+            alignas( inotify_event ) char buffer[4096];
+            ssize_t length;
+            while( ( length = read( mNotifyFd, buffer, sizeof( buffer ) ) ) > 0 ){
+                for( char *ptr = buffer; ptr < buffer + length; ){
+                    const inotify_event *event = reinterpret_cast<const inotify_event*>( ptr );
+                    if( event->mask & IN_Q_OVERFLOW ) overflow = true;
+                    else watches.push_back( event->wd );
+                    ptr += sizeof( inotify_event ) + event->len;
+                }
+            }
+        }
+
+        std::unique_lock<std::mutex> lock( mMutex );
+        for( auto &directory : mDirectories ){
+            const int watch = directory.second.watch;
+            // events got lost, look at everything. Directories without a watch get polled on every timeout.
+            if( overflow || ( watch < 0 && ready == 0 ) || std::find( watches.begin(), watches.end(), watch ) != watches.end() )
+                dirs.insert( directory.first );
+        }
+#endif
+        return std::vector<std::string>( dirs.begin(), dirs.end() );
+    }
+
+    void DirectoryWatcher::threadFn(){
+        CI_LOG_I( "DIRECTORYWATCHER THREAD STARTED" );
+        // run until interrupted
+        while( true ){
+            std::vector<std::string> dirs;
+            if( isNotifying() ){
+                dirs = waitForEvents();
+            } else {
+                std::unique_lock<std::mutex> lock( mMutex );
+                mCondition.wait_for( lock, std::chrono::duration<double>( mPollInterval ), [&](){ return mShouldQuit; } );
+                for( auto &directory : mDirectories ) dirs.push_back( directory.first );
+            }
+            {
+                std::unique_lock<std::mutex> lock( mMutex );
+                if( mShouldQuit ) break;
+            }
+            for( const std::string &dir : dirs ) rescan( dir );
+        }
+        CI_LOG_I( "DIRECTORYWATCHER THREAD STOPPED" );
+    }
+
+} // namespace rph
@@ -0,0 +1,114 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+
+#pragma once
+
+#include "cinder/Filesystem.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace rph {
+
+    typedef std::shared_ptr<class DirectoryWatcher> DirectoryWatcherRef;
+
+    //! watches the files in a set of directories for changes on its own thread. Uses inotify on Linux and
+    //! polls elsewhere, or when inotify isn't available. A file counts as changed when its modification time
+    //! or size differs from the last time it was looked at, so touching a file without writing it is ignored.
+    class DirectoryWatcher {
+      public:
+        struct Change {
+            enum Type { ADDED, MODIFIED, REMOVED };
+
+            Type        type;
+            //! the directory joined with the file name, the same string listImageDirectory() returns
+            std::string path;
+        };
+
+        static DirectoryWatcherRef create( double pollInterval = 1.0 ) { return DirectoryWatcherRef( new DirectoryWatcher( pollInterval ) ); }
+        ~DirectoryWatcher();
+
+        //! starts watching a directory, with the files as they are now as the baseline. Cheap for a directory
+        //! that is watched already, which is left as it is.
+        void    watch( const ci::fs::path &dir );
+        void    unwatch( const ci::fs::path &dir );
+        bool    isWatching( const ci::fs::path &dir );
+
+        //! true if the os reports changes, false if the directories are polled
+        bool    isNotifying() const { return mNotifyFd >= 0; }
+        //! how often the directories are polled without notifications, 1 s by default
+        void    setPollInterval( double seconds );
+
+        //! takes the changes found since the last call, in the order they were found
+        std::vector<Change> takeChanges();
+
+      protected:
+        DirectoryWatcher( double pollInterval );
+        DirectoryWatcher( DirectoryWatcher const& );
+        DirectoryWatcher& operator=( DirectoryWatcher const& );
+
+        //! what a change is detected by
+        struct FileState {
+            int64_t     modified;
+            uint64_t    size;
+
+            bool operator!=( const FileState &rhs ) const { return modified != rhs.modified || size != rhs.size; }
+        };
+        typedef std::map<std::string, FileState> Snapshot;
+
+        struct Directory {
+            ci::fs::path    path;
+            //! the inotify watch, -1 while polling
+            int             watch;
+            Snapshot        files;
+        };
+
+        void        threadFn();
+        //! blocks until a watched directory had events or the watcher stops, returns the directories to rescan
+        std::vector<std::string> waitForEvents();
+        //! compares a directory with its last snapshot and records the differences
+        void        rescan( const std::string &dir );
+        static Snapshot scan( const ci::fs::path &dir );
+
+        std::map<std::string, Directory>    mDirectories;
+        std::vector<Change>                 mChanges;
+        double                              mPollInterval;
+        bool                                mShouldQuit;
+        std::mutex                          mMutex;
+        std::condition_variable             mCondition;
+
+        //! inotify and a pipe to wake its thread with, -1 when polling
+        int                                 mNotifyFd;
+        int                                 mWakeFds[2];
+        std::shared_ptr<std::thread>        mThread;
+    };
+
+} // namespace rph
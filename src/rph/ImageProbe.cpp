@@ -0,0 +1,145 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "rph/ImageProbe.h"
+
+#include <fstream>
+#include <istream>
+#include <streambuf>
+
+namespace rph {
+
+    namespace {
+
+        //! reads from memory without copying it
+        class MemoryBuffer : public std::streambuf {
+          public:
+            MemoryBuffer( const char *data, size_t size ){
+                char *begin = const_cast<char*>( data );
+                setg( begin, begin, begin + size );
+            }
+        };
+
+        bool readBytes( std::istream &is, uint8_t *bytes, size_t count ){
+            return bool( is.read( reinterpret_cast<char*>( bytes ), std::streamsize( count ) ) );
+        }
+
+        uint32_t readBigEndian( const uint8_t *bytes, int count ){
+            uint32_t value = 0;
+            for( int i = 0; i < count; ++i ) value = ( value << 8 ) | bytes[i];
+            return value;
+        }
+
+        ImageInfo probePng( std::istream &is ){
+            // the 8 byte signature is followed by the IHDR chunk: length, type, width, height, bit depth, color type
+            uint8_t header[18];
+            ImageInfo info;
+            if( !readBytes( is, header, sizeof( header ) ) ) return info;
+            if( header[4] != 'I' || header[5] != 'H' || header[6] != 'D' || header[7] != 'R' ) return info;
+
+            switch( header[17] ){
+                case 0:     info.channels = 1; break;   // gray
+                case 2:     info.channels = 3; break;   // rgb
+                case 3:     info.channels = 3; break;   // palette, a tRNS chunk further down may add alpha
+                case 4:     info.channels = 2; break;   // gray + alpha
+                case 6:     info.channels = 4; break;   // rgba
+                default:    return info;
+            }
+            info.width = int32_t( readBigEndian( header + 8, 4 ) );
+            info.height = int32_t( readBigEndian( header + 12, 4 ) );
+            return info;
+        }
+
+        ImageInfo probeJpeg( std::istream &is ){
+            ImageInfo info;
+            uint8_t marker[2];
+            while( readBytes( is, marker, 2 ) ){
+                if( marker[0] != 0xFF ) return info;
+                // markers may be padded with any number of fill bytes
+                while( marker[1] == 0xFF ){
+                    if( !readBytes( is, marker + 1, 1 ) ) return info;
+                }
+
+                // standalone markers without a length
+                if( marker[1] == 0x01 || ( marker[1] >= 0xD0 && marker[1] <= 0xD7 ) ) continue;
+                // start of scan or end of image without a frame header
+                if( marker[1] == 0xDA || marker[1] == 0xD9 ) return info;
+
+                uint8_t length[2];
+                if( !readBytes( is, length, 2 ) ) return info;
+                uint32_t segmentLength = readBigEndian( length, 2 );
+                if( segmentLength < 2 ) return info;
+
+                // SOF0-SOF15, except DHT (C4), JPG (C8) and DAC (CC)
+                bool isFrame = marker[1] >= 0xC0 && marker[1] <= 0xCF && marker[1] != 0xC4 && marker[1] != 0xC8 && marker[1] != 0xCC;
+                if( !isFrame ){
+                    // skip over metadata like EXIF and ICC profiles
+                    is.ignore( std::streamsize( segmentLength - 2 ) );
+                    continue;
+                }
+
+                // precision, height, width, number of components
+                uint8_t frame[6];
+                if( !readBytes( is, frame, sizeof( frame ) ) ) return info;
+                info.height = int32_t( readBigEndian( frame + 1, 2 ) );
+                info.width = int32_t( readBigEndian( frame + 3, 2 ) );
+                info.channels = frame[5];
+                return info;
+            }
+            return info;
+        }
+
+    } // anonymous namespace
+
+    ImageInfo probeImage( std::istream &is ){
+        uint8_t signature[8];
+        if( !readBytes( is, signature, 2 ) ) return ImageInfo();
+
+        if( signature[0] == 0xFF && signature[1] == 0xD8 ) return probeJpeg( is );
+
+        static const uint8_t PNG_SIGNATURE[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+        if( signature[0] == PNG_SIGNATURE[0] && signature[1] == PNG_SIGNATURE[1] ){
+            if( !readBytes( is, signature + 2, 6 ) ) return ImageInfo();
+            for( int i = 2; i < 8; ++i ){
+                if( signature[i] != PNG_SIGNATURE[i] ) return ImageInfo();
+            }
+            return probePng( is );
+        }
+        return ImageInfo();
+    }
+
+    ImageInfo probeImage( const void *data, size_t size ){
+        MemoryBuffer buffer( static_cast<const char*>( data ), size );
+        std::istream is( &buffer );
+        return probeImage( is );
+    }
+
+    ImageInfo probeImageFile( const std::string &path ){
+        std::ifstream file( path.c_str(), std::ios::binary );
+        if( !file.is_open() ) return ImageInfo();
+
+        return probeImage( file );
+    }
+
+} // namespace rph
@@ -0,0 +1,50 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+namespace rph {
+
+    //! what an image file header tells about the image without decoding it
+    struct ImageInfo {
+        int32_t     width       = 0;
+        int32_t     height      = 0;
+        //! 1 for gray, 2 for gray with alpha, 3 for rgb (and palettes), 4 for rgba or cmyk
+        int32_t     channels    = 0;
+
+        bool isValid() const { return width > 0 && height > 0; }
+    };
+
+    //! reads the dimensions and channel count from a JPEG SOF or PNG IHDR header. Only reads as far as the
+    //! header, skipping over metadata segments. Returns an invalid ImageInfo for anything else.
+    ImageInfo probeImage( std::istream &is );
+    ImageInfo probeImage( const void *data, size_t size );
+    ImageInfo probeImageFile( const std::string &path );
+
+} // namespace rph
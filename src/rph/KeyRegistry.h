@@ -0,0 +1,210 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rph {
+
+    //! the texture parameters that make two loads of the same url produce different textures.
+    //! kept free of GL headers so the registry can be used (and benchmarked) without a context.
+    struct FormatDescriptor {
+        uint32_t    target          = 0;
+        uint32_t    wrapS           = 0;
+        uint32_t    wrapT           = 0;
+        uint32_t    wrapR           = 0;
+        uint32_t    minFilter       = 0;
+        uint32_t    magFilter       = 0;
+        int32_t     internalFormat  = 0;
+        uint32_t    dataType        = 0;
+        float       maxAnisotropy   = 0.0f;
+        bool        mipmapping      = false;
+        int32_t     baseMipLevel    = 0;
+        int32_t     maxMipLevel     = 0;
+        //! flips the rows on upload, so the same file gives a different texture
+        bool        loadTopDown     = false;
+        std::array<int32_t, 4>  swizzle     = {{ 0, 0, 0, 0 }};
+        uint32_t    compareMode     = 0;
+        uint32_t    compareFunc     = 0;
+        std::array<float, 4>    borderColor = {{ 0.0f, 0.0f, 0.0f, 0.0f }};
+
+        bool operator==( const FormatDescriptor &rhs ) const {
+            return target == rhs.target && wrapS == rhs.wrapS && wrapT == rhs.wrapT && wrapR == rhs.wrapR
+                && minFilter == rhs.minFilter && magFilter == rhs.magFilter
+                && internalFormat == rhs.internalFormat && dataType == rhs.dataType
+                && maxAnisotropy == rhs.maxAnisotropy && mipmapping == rhs.mipmapping
+                && baseMipLevel == rhs.baseMipLevel && maxMipLevel == rhs.maxMipLevel
+                && loadTopDown == rhs.loadTopDown && swizzle == rhs.swizzle
+                && compareMode == rhs.compareMode && compareFunc == rhs.compareFunc
+                && borderColor == rhs.borderColor;
+        }
+        bool operator!=( const FormatDescriptor &rhs ) const { return !( *this == rhs ); }
+    };
+
+    //! handle to an interned (url, format) pair. Hold on to it to skip string hashing on every lookup.
+    class TextureKey {
+      public:
+        static const uint32_t INVALID_ID = 0xFFFFFFFF;
+
+        TextureKey() : mId( INVALID_ID ) {}
+        explicit TextureKey( uint32_t id ) : mId( id ) {}
+
+        uint32_t    getId() const { return mId; }
+        bool        isValid() const { return mId != INVALID_ID; }
+
+        bool operator==( const TextureKey &rhs ) const { return mId == rhs.mId; }
+        bool operator!=( const TextureKey &rhs ) const { return mId != rhs.mId; }
+        bool operator<( const TextureKey &rhs ) const { return mId < rhs.mId; }
+
+      private:
+        uint32_t    mId;
+    };
+
+    //! interns urls and (url, format) pairs into compact ids. Ids are never recycled, so a key
+    //! stays valid for the lifetime of the registry. All methods are thread safe.
+    class KeyRegistry {
+      public:
+        KeyRegistry(){};
+        ~KeyRegistry(){};
+
+        //! returns the id for a url, adding it if it has not been seen before
+        uint32_t internUrl( const std::string &url ){
+            std::unique_lock<std::mutex> lock( mMutex );
+            return internUrlLocked( url );
+        }
+
+        //! returns the key for a (url, format) pair, adding it if it has not been seen before
+        TextureKey intern( const std::string &url, const FormatDescriptor &fmt ){
+            std::unique_lock<std::mutex> lock( mMutex );
+            uint32_t urlId = internUrlLocked( url );
+            uint32_t fmtId = internFormatLocked( fmt );
+
+            uint64_t pair = ( uint64_t( urlId ) << 32 ) | fmtId;
+            auto itr = mKeyIds.find( pair );
+            if( itr != mKeyIds.end() )
+                return TextureKey( itr->second );
+
+            uint32_t id = uint32_t( mKeys.size() );
+            mKeys.push_back( Entry{ urlId, fmtId } );
+            mKeyIds[ pair ] = id;
+            return TextureKey( id );
+        }
+
+        //! returns the key for a (url, format) pair, or an invalid key if it was never interned
+        TextureKey find( const std::string &url, const FormatDescriptor &fmt ) const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            auto urlItr = mUrlIds.find( url );
+            if( urlItr == mUrlIds.end() )
+                return TextureKey();
+            for( uint32_t fmtId = 0; fmtId < mFormats.size(); ++fmtId ){
+                if( mFormats[ fmtId ] == fmt ){
+                    auto itr = mKeyIds.find( ( uint64_t( urlItr->second ) << 32 ) | fmtId );
+                    return ( itr != mKeyIds.end() ) ? TextureKey( itr->second ) : TextureKey();
+                }
+            }
+            return TextureKey();
+        }
+
+        //! returns the id of a url, or INVALID_ID if it was never interned
+        uint32_t findUrl( const std::string &url ) const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            auto itr = mUrlIds.find( url );
+            return ( itr != mUrlIds.end() ) ? itr->second : TextureKey::INVALID_ID;
+        }
+
+        std::string getUrl( uint32_t urlId ) const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            return ( urlId < mUrls.size() ) ? mUrls[ urlId ] : std::string();
+        }
+        std::string getUrl( TextureKey key ) const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            return key.getId() < mKeys.size() ? mUrls[ mKeys[ key.getId() ].urlId ] : std::string();
+        }
+        uint32_t getUrlId( TextureKey key ) const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            return key.getId() < mKeys.size() ? mKeys[ key.getId() ].urlId : TextureKey::INVALID_ID;
+        }
+        FormatDescriptor getFormat( TextureKey key ) const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            return key.getId() < mKeys.size() ? mFormats[ mKeys[ key.getId() ].formatId ] : FormatDescriptor();
+        }
+
+        size_t getUrlCount() const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            return mUrls.size();
+        }
+        size_t getKeyCount() const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            return mKeys.size();
+        }
+
+      private:
+        struct Entry {
+            uint32_t    urlId;
+            uint32_t    formatId;
+        };
+
+        uint32_t internUrlLocked( const std::string &url ){
+            auto itr = mUrlIds.find( url );
+            if( itr != mUrlIds.end() )
+                return itr->second;
+
+            uint32_t id = uint32_t( mUrls.size() );
+            mUrls.push_back( url );
+            mUrlIds[ url ] = id;
+            return id;
+        }
+
+        uint32_t internFormatLocked( const FormatDescriptor &fmt ){
+            // an application uses a handful of formats at most, a linear scan beats hashing here
+            for( uint32_t i = 0; i < mFormats.size(); ++i ){
+                if( mFormats[ i ] == fmt ) return i;
+            }
+            mFormats.push_back( fmt );
+            return uint32_t( mFormats.size() - 1 );
+        }
+
+        std::deque<std::string>                     mUrls;
+        std::unordered_map<std::string, uint32_t>   mUrlIds;
+        std::vector<FormatDescriptor>               mFormats;
+        std::vector<Entry>                          mKeys;
+        std::unordered_map<uint64_t, uint32_t>      mKeyIds;
+        mutable std::mutex                          mMutex;
+    };
+
+} // namespace rph
+
+namespace std {
+    template<> struct hash<rph::TextureKey> {
+        size_t operator()( const rph::TextureKey &key ) const { return std::hash<uint32_t>()( key.getId() ); }
+    };
+} // namespace std
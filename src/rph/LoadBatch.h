@@ -0,0 +1,100 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+namespace rph {
+
+    typedef std::shared_ptr<class LoadBatch> LoadBatchRef;
+
+    //! one handle for a batch of images queued together. Every image of the batch is done once it has been
+    //! decoded, skipped because it was decoded already or didn't fit the prefetch budget, or failed to load.
+    class LoadBatch {
+      public:
+        //! a batch of count images of which the pending ones still have to be decoded
+        static LoadBatchRef create( const std::vector<uint32_t> &pending, size_t count ) { return LoadBatchRef( new LoadBatch( pending, count ) ); }
+
+        size_t  getCount() const { return mCount; }
+        size_t  getDoneCount() const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            return mCount - mPending.size();
+        }
+        bool    isDone() const { return getDoneCount() == mCount; }
+        float   getProgress() const { return mCount > 0 ? float( getDoneCount() ) / float( mCount ) : 1.0f; }
+
+        //! returns true while an image of the batch still has to be decoded
+        bool    isPending( uint32_t urlId ) const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            return mPending.find( urlId ) != mPending.end();
+        }
+
+        //! the images that have been marked done, in order, from the first from of them on. Keep a cursor
+        //! to see each of them once. Images that were done when the batch was queued aren't in here.
+        std::vector<uint32_t> getFinished( size_t from ) const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            return ( from < mFinished.size() ) ? std::vector<uint32_t>( mFinished.begin() + from, mFinished.end() ) : std::vector<uint32_t>();
+        }
+
+        //! blocks until every image of the batch is done
+        void    wait() const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            mCondition.wait( lock, [&](){ return mPending.empty(); } );
+        }
+        //! blocks until more than doneCount images are done or the batch is, returns the number done
+        size_t  waitForMore( size_t doneCount ) const {
+            std::unique_lock<std::mutex> lock( mMutex );
+            mCondition.wait( lock, [&](){ return mPending.empty() || mCount - mPending.size() > doneCount; } );
+            return mCount - mPending.size();
+        }
+
+        //! marks an image as done, returns false if it wasn't pending in this batch
+        bool    finish( uint32_t urlId ){
+            std::unique_lock<std::mutex> lock( mMutex );
+            if( mPending.erase( urlId ) == 0 ) return false;
+            mFinished.push_back( urlId );
+            lock.unlock();
+            mCondition.notify_all();
+            return true;
+        }
+
+      protected:
+        LoadBatch( const std::vector<uint32_t> &pending, size_t count )
+        : mPending( pending.begin(), pending.end() ), mCount( count ) {}
+
+        std::unordered_set<uint32_t>        mPending;
+        std::vector<uint32_t>               mFinished;
+        size_t                              mCount;
+        mutable std::mutex                  mMutex;
+        mutable std::condition_variable     mCondition;
+    };
+
+} // namespace rph
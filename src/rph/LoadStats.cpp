@@ -0,0 +1,222 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "rph/LoadStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <ostream>
+
+namespace rph {
+
+    namespace {
+        void writeJsonString( std::ostream &os, const std::string &str ){
+            os << '"';
+            for( char c : str ){
+                switch( c ){
+                    case '"':   os << "\\\""; break;
+                    case '\\':  os << "\\\\"; break;
+                    case '\n':  os << "\\n"; break;
+                    case '\t':  os << "\\t"; break;
+                    default:
+                        if( (unsigned char)c < 0x20 ) os << ' ';
+                        else os << c;
+                }
+            }
+            os << '"';
+        }
+    } // anonymous namespace
+
+    const char* getStageName( LoadStage stage ){
+        switch( stage ){
+            case LoadStage::RESOLVE:            return "resolve";
+            case LoadStage::READ:               return "read";
+            case LoadStage::DECODE:             return "decode";
+            case LoadStage::CONVERT:            return "convert";
+            case LoadStage::UPLOAD:             return "upload";
+            case LoadStage::PROBE:              return "probe";
+            case LoadStage::GARBAGE_COLLECT:    return "gc";
+            default:                            return "unknown";
+        }
+    }
+
+    // ----------------------------------------------------------------------------------------------------
+    // LatencyHistogram
+
+    LatencyHistogram::LatencyHistogram(){
+        reset();
+    }
+
+    void LatencyHistogram::reset(){
+        for( int i = 0; i < NUM_BUCKETS; ++i ) mBuckets[i] = 0;
+        mCount = 0;
+        mTotal = 0;
+        mMax = 0;
+    }
+
+    void LatencyHistogram::add( uint64_t micros ){
+        // bucket i holds durations below 2^(i+1) microseconds
+        int bucket = 0;
+        while( bucket < NUM_BUCKETS - 1 && ( micros >> ( bucket + 1 ) ) > 0 ) ++bucket;
+
+        mBuckets[bucket]++;
+        mCount++;
+        mTotal += micros;
+
+        uint64_t prevMax = mMax;
+        while( micros > prevMax && !mMax.compare_exchange_weak( prevMax, micros ) ) {}
+    }
+
+    double LatencyHistogram::getMeanMicros() const {
+        uint64_t count = mCount;
+        return count > 0 ? double( mTotal ) / double( count ) : 0.0;
+    }
+
+    uint64_t LatencyHistogram::getPercentileMicros( double percentile ) const {
+        uint64_t count = mCount;
+        if( count == 0 ) return 0;
+
+        uint64_t target = std::max<uint64_t>( 1, uint64_t( percentile * double( count ) + 0.5 ) );
+        uint64_t seen = 0;
+        for( int i = 0; i < NUM_BUCKETS; ++i ){
+            seen += mBuckets[i];
+            if( seen >= target ) return std::min<uint64_t>( ( uint64_t( 1 ) << ( i + 1 ) ) - 1, mMax );
+        }
+        return mMax;
+    }
+
+    // ----------------------------------------------------------------------------------------------------
+    // LoadStats
+
+    LoadStats::LoadStats()
+        : mBytesDecoded( 0 ), mTracing( false ), mMaxTraceEvents( 0 )
+    {
+    }
+
+    uint64_t LoadStats::now(){
+        return std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    void LoadStats::record( LoadStage stage, uint64_t startMicros, uint64_t endMicros, const std::string *name ){
+        uint64_t duration = endMicros > startMicros ? endMicros - startMicros : 0;
+        mStages[int( stage )].add( duration );
+
+        if( mTracing ){
+            std::unique_lock<std::mutex> lock( mTraceMutex );
+            if( mTrace.size() < mMaxTraceEvents ){
+                TraceEvent event;
+                event.name = name ? *name : getStageName( stage );
+                event.category = getStageName( stage );
+                event.start = startMicros;
+                event.duration = duration;
+                event.thread = threadIndexLocked( std::this_thread::get_id() );
+                mTrace.push_back( event );
+            }
+        }
+    }
+
+    LoadStats::Summary LoadStats::getSummary() const {
+        Summary summary;
+        summary.bytesDecoded = mBytesDecoded;
+        for( int i = 0; i < int( LoadStage::COUNT ); ++i ){
+            const LatencyHistogram &hist = mStages[i];
+            StageSummary &stage = summary.stages[i];
+            stage.count = hist.getCount();
+            stage.meanMicros = hist.getMeanMicros();
+            stage.p50Micros = hist.getPercentileMicros( 0.50 );
+            stage.p95Micros = hist.getPercentileMicros( 0.95 );
+            stage.p99Micros = hist.getPercentileMicros( 0.99 );
+            stage.maxMicros = hist.getMaxMicros();
+        }
+        return summary;
+    }
+
+    void LoadStats::reset(){
+        for( int i = 0; i < int( LoadStage::COUNT ); ++i ) mStages[i].reset();
+        mBytesDecoded = 0;
+        clearTrace();
+    }
+
+    void LoadStats::setTracingEnabled( bool enabled, size_t maxEvents ){
+        std::unique_lock<std::mutex> lock( mTraceMutex );
+        mMaxTraceEvents = maxEvents;
+        mTrace.reserve( std::min<size_t>( maxEvents, 4096 ) );
+        mTracing = enabled;
+    }
+
+    void LoadStats::clearTrace(){
+        std::unique_lock<std::mutex> lock( mTraceMutex );
+        mTrace.clear();
+    }
+
+    void LoadStats::addTraceEvent( const std::string &name, const std::string &category, uint64_t startMicros, uint64_t endMicros ){
+        if( !mTracing ) return;
+
+        std::unique_lock<std::mutex> lock( mTraceMutex );
+        if( mTrace.size() >= mMaxTraceEvents ) return;
+
+        TraceEvent event;
+        event.name = name;
+        event.category = category;
+        event.start = startMicros;
+        event.duration = endMicros > startMicros ? endMicros - startMicros : 0;
+        event.thread = threadIndexLocked( std::this_thread::get_id() );
+        mTrace.push_back( event );
+    }
+
+    uint32_t LoadStats::threadIndexLocked( std::thread::id id ){
+        auto itr = std::find( mTraceThreads.begin(), mTraceThreads.end(), id );
+        if( itr != mTraceThreads.end() )
+            return uint32_t( itr - mTraceThreads.begin() );
+
+        mTraceThreads.push_back( id );
+        return uint32_t( mTraceThreads.size() - 1 );
+    }
+
+    void LoadStats::writeChromeTrace( std::ostream &os ) const {
+        std::unique_lock<std::mutex> lock( mTraceMutex );
+
+        os << "{\"traceEvents\":[";
+        for( size_t i = 0; i < mTrace.size(); ++i ){
+            const TraceEvent &event = mTrace[i];
+            os << ( i > 0 ? ",\n" : "\n" ) << "{\"name\":";
+            writeJsonString( os, event.name );
+            os << ",\"cat\":";
+            writeJsonString( os, event.category );
+            os << ",\"ph\":\"X\",\"ts\":" << event.start << ",\"dur\":" << event.duration
+               << ",\"pid\":1,\"tid\":" << event.thread << "}";
+        }
+        os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    }
+
+    bool LoadStats::saveChromeTrace( const std::string &path ) const {
+        std::ofstream file( path.c_str() );
+        if( !file.is_open() ) return false;
+
+        writeChromeTrace( file );
+        return file.good();
+    }
+
+} // namespace rph
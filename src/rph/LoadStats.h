@@ -0,0 +1,174 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rph/LruCache.h"
+
+//! define RPH_TEXTURESTORE_STATS to 0 to compile the load pipeline instrumentation away
+#ifndef RPH_TEXTURESTORE_STATS
+    #define RPH_TEXTURESTORE_STATS 1
+#endif
+
+#if RPH_TEXTURESTORE_STATS
+    #define RPH_STATS_CONCAT_IMPL( a, b ) a##b
+    #define RPH_STATS_CONCAT( a, b ) RPH_STATS_CONCAT_IMPL( a, b )
+    //! times the rest of the enclosing scope as one pipeline stage
+    #define RPH_STATS_SCOPE( stats, ... ) ::rph::ScopedStage RPH_STATS_CONCAT( rphScopedStage, __LINE__ )( stats, __VA_ARGS__ )
+    //! evaluates a statement only when instrumentation is compiled in
+    #define RPH_STATS( statement ) statement
+#else
+    #define RPH_STATS_SCOPE( stats, ... ) ((void)0)
+    #define RPH_STATS( statement ) ((void)0)
+#endif
+
+namespace rph {
+
+    //! the steps an image goes through from url to texture
+    enum class LoadStage { RESOLVE, READ, DECODE, CONVERT, UPLOAD, PROBE, GARBAGE_COLLECT, COUNT };
+
+    const char* getStageName( LoadStage stage );
+
+    //! latency histogram with power of two microsecond buckets, safe to update from any thread
+    class LatencyHistogram {
+      public:
+        static const int NUM_BUCKETS = 32;
+
+        LatencyHistogram();
+
+        void        add( uint64_t micros );
+        void        reset();
+
+        uint64_t    getCount() const { return mCount; }
+        uint64_t    getTotalMicros() const { return mTotal; }
+        uint64_t    getMaxMicros() const { return mMax; }
+        double      getMeanMicros() const;
+        //! upper bound of the bucket that holds the given percentile (0-1)
+        uint64_t    getPercentileMicros( double percentile ) const;
+
+      private:
+        std::atomic<uint64_t>   mBuckets[NUM_BUCKETS];
+        std::atomic<uint64_t>   mCount;
+        std::atomic<uint64_t>   mTotal;
+        std::atomic<uint64_t>   mMax;
+    };
+
+    //! counters, latency histograms and an optional Chrome trace of the load pipeline
+    class LoadStats {
+      public:
+        struct StageSummary {
+            uint64_t    count = 0;
+            double      meanMicros = 0.0;
+            uint64_t    p50Micros = 0;
+            uint64_t    p95Micros = 0;
+            uint64_t    p99Micros = 0;
+            uint64_t    maxMicros = 0;
+        };
+
+        //! a copy of all numbers at one point in time
+        struct Summary {
+            int             queueDepth = 0;
+            int             inFlight = 0;
+            uint64_t        bytesDecoded = 0;
+            uint64_t        bytesResident = 0;
+            uint64_t        cpuTierBytes = 0;
+            CacheStats      gpuTier;
+            CacheStats      cpuTier;
+            StageSummary    stages[int( LoadStage::COUNT )];
+
+            const StageSummary& getStage( LoadStage stage ) const { return stages[int( stage )]; }
+        };
+
+        LoadStats();
+
+        //! microseconds on a monotonic clock, the time base of all recorded events
+        static uint64_t now();
+
+        void record( LoadStage stage, uint64_t startMicros, uint64_t endMicros, const std::string *name = nullptr );
+        void addBytesDecoded( uint64_t bytes ) { mBytesDecoded += bytes; }
+
+        //! fills in the stage latencies and counters, the owner adds the gauges and cache numbers
+        Summary getSummary() const;
+        void    reset();
+
+        //! starts or stops recording trace events, keeping at most maxEvents of them
+        void    setTracingEnabled( bool enabled, size_t maxEvents = 1 << 16 );
+        bool    isTracingEnabled() const { return mTracing; }
+        void    clearTrace();
+        //! adds an event of your own to the trace, e.g. one per frame to line loads up with dropped frames
+        void    addTraceEvent( const std::string &name, const std::string &category, uint64_t startMicros, uint64_t endMicros );
+
+        //! writes the trace in the Chrome trace event format, load it in chrome://tracing or ui.perfetto.dev
+        void    writeChromeTrace( std::ostream &os ) const;
+        bool    saveChromeTrace( const std::string &path ) const;
+
+      private:
+        struct TraceEvent {
+            std::string     name;
+            std::string     category;
+            uint64_t        start;
+            uint64_t        duration;
+            uint32_t        thread;
+        };
+
+        uint32_t threadIndexLocked( std::thread::id id );
+
+        LatencyHistogram            mStages[int( LoadStage::COUNT )];
+        std::atomic<uint64_t>       mBytesDecoded;
+
+        std::atomic<bool>           mTracing;
+        size_t                      mMaxTraceEvents;
+        std::vector<TraceEvent>     mTrace;
+        std::vector<std::thread::id> mTraceThreads;
+        mutable std::mutex          mTraceMutex;
+    };
+
+    //! records the lifetime of the object as one stage, see RPH_STATS_SCOPE
+    class ScopedStage {
+      public:
+        ScopedStage( LoadStats &stats, LoadStage stage, const std::string &name )
+            : mStats( stats ), mStage( stage ), mName( &name ), mStart( LoadStats::now() ) {}
+        ScopedStage( LoadStats &stats, LoadStage stage )
+            : mStats( stats ), mStage( stage ), mName( nullptr ), mStart( LoadStats::now() ) {}
+        ~ScopedStage() { mStats.record( mStage, mStart, LoadStats::now(), mName ); }
+
+      private:
+        ScopedStage( const ScopedStage& );
+        ScopedStage& operator=( const ScopedStage& );
+
+        LoadStats           &mStats;
+        LoadStage           mStage;
+        const std::string   *mName;
+        uint64_t            mStart;
+    };
+
+} // namespace rph
@@ -0,0 +1,135 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+namespace rph {
+
+    //! scales the number of active decode threads and the bytes uploaded per frame from the time frames spend working.
+    //! Backs off as soon as frames run late and creeps back up once there has been headroom for a while,
+    //! so loading never costs more than the frame can spare. Meant to be fed from the main thread.
+    class LoadThrottle {
+      public:
+        LoadThrottle( int maxDecoders = 1, size_t maxUploadBytes = 64 * 1024 * 1024 )
+        : mTargetFrameTime( 1.0 / 60.0 ), mMinUploadBytes( 1024 * 1024 )
+        {
+            mMaxDecoders = std::max( 1, maxDecoders );
+            mMaxUploadBytes = std::max( maxUploadBytes, mMinUploadBytes );
+            reset();
+        }
+
+        //! the frame time to stay under, 1/60 s by default
+        void    setTargetFrameTime( double seconds ) { mTargetFrameTime = std::max( seconds, 0.0001 ); }
+        double  getTargetFrameTime() const { return mTargetFrameTime; }
+
+        void    setMaxDecoders( int decoders ) { mMaxDecoders = std::max( 1, decoders ); mDecoders = std::min( mDecoders, mMaxDecoders ); }
+        int     getMaxDecoders() const { return mMaxDecoders; }
+        void    setMaxUploadBytes( size_t bytes ) { mMaxUploadBytes = std::max( bytes, mMinUploadBytes ); mUploadBytes = std::min( mUploadBytes, mMaxUploadBytes ); }
+        size_t  getMaxUploadBytes() const { return mMaxUploadBytes; }
+
+        //! decode threads allowed to work right now, never less than one
+        int     getDecoders() const { return mDecoders; }
+        //! bytes that may be uploaded in the current frame. At least one upload per frame always goes through.
+        size_t  getUploadBytes() const { return mUploadBytes; }
+        double  getSmoothedFrameTime() const { return mSmoothed; }
+
+        //! starts over at the maximum limits
+        void reset(){
+            mDecoders = mMaxDecoders;
+            mUploadBytes = mMaxUploadBytes;
+            mSmoothed = 0.0;
+            mCooldown = 0;
+            mHeadroomFrames = 0;
+        }
+
+        //! feeds in how long the last frame worked, without the wait for vsync, returns true if the limits changed
+        bool addFrameTime( double seconds ){
+            // react to single long frames right away, to slow drifts through the average
+            mSmoothed = ( mSmoothed > 0.0 ) ? mSmoothed + ( seconds - mSmoothed ) * SMOOTHING : seconds;
+            if( mCooldown > 0 ) mCooldown--;
+
+            const bool overrun = seconds > mTargetFrameTime * SPIKE_RATIO || mSmoothed > mTargetFrameTime * OVERRUN_RATIO;
+            if( overrun ){
+                mHeadroomFrames = 0;
+                // give the last step a few frames to show before backing off further
+                if( mCooldown > 0 ) return false;
+                mCooldown = COOLDOWN_FRAMES;
+                return backOff();
+            }
+
+            if( mSmoothed < mTargetFrameTime * HEADROOM_RATIO ){
+                if( ++mHeadroomFrames >= HEADROOM_FRAMES ){
+                    mHeadroomFrames = 0;
+                    return speedUp();
+                }
+            } else {
+                mHeadroomFrames = 0;
+            }
+            return false;
+        }
+
+      private:
+        //! halve the uploads and take one decoder off
+        bool backOff(){
+            int decoders = std::max( 1, mDecoders - 1 );
+            size_t uploadBytes = std::max( mMinUploadBytes, mUploadBytes / 2 );
+            bool changed = decoders != mDecoders || uploadBytes != mUploadBytes;
+            mDecoders = decoders;
+            mUploadBytes = uploadBytes;
+            return changed;
+        }
+
+        //! add back half of what the uploads lost and one decoder
+        bool speedUp(){
+            int decoders = std::min( mMaxDecoders, mDecoders + 1 );
+            size_t uploadBytes = std::min( mMaxUploadBytes, mUploadBytes + std::max( mMinUploadBytes, mUploadBytes / 2 ) );
+            bool changed = decoders != mDecoders || uploadBytes != mUploadBytes;
+            mDecoders = decoders;
+            mUploadBytes = uploadBytes;
+            return changed;
+        }
+
+        static constexpr double SMOOTHING       = 0.1;
+        static constexpr double SPIKE_RATIO     = 1.5;
+        static constexpr double OVERRUN_RATIO   = 1.05;
+        static constexpr double HEADROOM_RATIO  = 0.85;
+        static const int        COOLDOWN_FRAMES = 10;
+        static const int        HEADROOM_FRAMES = 30;
+
+        double  mTargetFrameTime;
+        size_t  mMinUploadBytes;
+        int     mMaxDecoders;
+        size_t  mMaxUploadBytes;
+
+        int     mDecoders;
+        size_t  mUploadBytes;
+        double  mSmoothed;
+        int     mCooldown;
+        int     mHeadroomFrames;
+    };
+
+} // namespace rph
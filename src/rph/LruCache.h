@@ -0,0 +1,216 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace rph {
+
+//! hit/miss counters of a cache tier
+struct CacheStats
+{
+	uint64_t	hits = 0;
+	uint64_t	misses = 0;
+	uint64_t	evictions = 0;
+
+	double getHitRatio() const { return ( hits + misses ) > 0 ? double( hits ) / double( hits + misses ) : 0.0; }
+};
+
+//! thread safe least-recently-used cache that evicts entries once their total size exceeds a byte budget
+template<typename Key, typename Data>
+class LruCache
+{
+public:
+	LruCache(size_t budget = 0) : mBudget( budget ), mBytes( 0 ) {};
+	~LruCache(void){};
+
+	void setBudget(size_t budget){
+		std::unique_lock<std::mutex> lock( mMutex );
+		mBudget = budget;
+		shrinkLocked();
+	}
+
+	size_t getBudget() const{
+		std::unique_lock<std::mutex> lock( mMutex );
+		return mBudget;
+	}
+
+	//! total size in bytes of all cached entries
+	size_t getBytes() const{
+		std::unique_lock<std::mutex> lock( mMutex );
+		return mBytes;
+	}
+
+	int size() const{
+		std::unique_lock<std::mutex> lock( mMutex );
+		return (int)mEntries.size();
+	}
+
+	CacheStats getStats() const{
+		std::unique_lock<std::mutex> lock( mMutex );
+		return mStats;
+	}
+
+	void clear(){
+		std::unique_lock<std::mutex> lock( mMutex );
+		mEntries.clear();
+		mOrder.clear();
+		mBytes = 0;
+	}
+
+	bool contains(Key const& key) const{
+		std::unique_lock<std::mutex> lock( mMutex );
+		return mEntries.find(key) != mEntries.end();
+	}
+
+	bool erase(Key const& key){
+		std::unique_lock<std::mutex> lock( mMutex );
+
+		typename std::unordered_map<Key, Entry>::iterator itr = mEntries.find(key);
+		if(itr == mEntries.end())
+			return false;
+
+		eraseLocked(itr);
+		return true;
+	}
+
+	//! inserts or replaces an entry and makes it the most recently used one. Entries larger than the budget are refused.
+	bool put(Key const& key, Data const& data, size_t bytes){
+		std::unique_lock<std::mutex> lock( mMutex );
+
+		typename std::unordered_map<Key, Entry>::iterator itr = mEntries.find(key);
+		if(itr != mEntries.end())
+			eraseLocked(itr);
+
+		if(bytes > mBudget)
+			return false;
+
+		mOrder.push_front(key);
+		Entry &entry = mEntries[key];
+		entry.data = data;
+		entry.bytes = bytes;
+		entry.position = mOrder.begin();
+		mBytes += bytes;
+
+		shrinkLocked();
+		return true;
+	}
+
+	//! inserts an entry only if it fits in the budget next to the others, without evicting any
+	bool putIfFits(Key const& key, Data const& data, size_t bytes){
+		std::unique_lock<std::mutex> lock( mMutex );
+
+		typename std::unordered_map<Key, Entry>::iterator itr = mEntries.find(key);
+		if(itr != mEntries.end())
+			eraseLocked(itr);
+
+		if(mBytes + bytes > mBudget)
+			return false;
+
+		mOrder.push_front(key);
+		Entry &entry = mEntries[key];
+		entry.data = data;
+		entry.bytes = bytes;
+		entry.position = mOrder.begin();
+		mBytes += bytes;
+		return true;
+	}
+
+	//! returns an entry and marks it as most recently used
+	bool get(Key const& key, Data& value){
+		std::unique_lock<std::mutex> lock( mMutex );
+
+		typename std::unordered_map<Key, Entry>::iterator itr = mEntries.find(key);
+		if(itr == mEntries.end()) {
+			mStats.misses++;
+			return false;
+		}
+
+		mOrder.splice(mOrder.begin(), mOrder, itr->second.position);
+		value = itr->second.data;
+		mStats.hits++;
+		return true;
+	}
+
+	//! returns an entry without counting a hit or miss and without marking it as used
+	bool peek(Key const& key, Data& value) const{
+		std::unique_lock<std::mutex> lock( mMutex );
+
+		typename std::unordered_map<Key, Entry>::const_iterator itr = mEntries.find(key);
+		if(itr == mEntries.end())
+			return false;
+
+		value = itr->second.data;
+		return true;
+	}
+
+	//! removes an entry and returns it, used when it is promoted to another tier
+	bool take(Key const& key, Data& value){
+		std::unique_lock<std::mutex> lock( mMutex );
+
+		typename std::unordered_map<Key, Entry>::iterator itr = mEntries.find(key);
+		if(itr == mEntries.end()) {
+			mStats.misses++;
+			return false;
+		}
+
+		value = itr->second.data;
+		eraseLocked(itr);
+		mStats.hits++;
+		return true;
+	}
+
+private:
+	struct Entry {
+		Data								data;
+		size_t								bytes;
+		typename std::list<Key>::iterator	position;
+	};
+
+	void eraseLocked(typename std::unordered_map<Key, Entry>::iterator itr){
+		mBytes -= itr->second.bytes;
+		mOrder.erase(itr->second.position);
+		mEntries.erase(itr);
+	}
+
+	void shrinkLocked(){
+		while(mBytes > mBudget && !mOrder.empty()) {
+			eraseLocked(mEntries.find(mOrder.back()));
+			mStats.evictions++;
+		}
+	}
+
+	std::unordered_map<Key, Entry>	mEntries;
+	std::list<Key>					mOrder;
+	size_t							mBudget;
+	size_t							mBytes;
+	CacheStats						mStats;
+	mutable std::mutex				mMutex;
+};
+
+} // namespace rph
@@ -0,0 +1,830 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ SurfaceStore is based on work by Paul Houx
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "rph/SurfaceStore.h"
+
+#include "cinder/Log.h"
+#include "cinder/Url.h"
+
+namespace rph {
+
+    SurfaceStore::SurfaceStore( const DecodePoolRef &pool )
+    : mPool( pool )
+    {
+        // initialize buffers
+        mSurfaceRefs.clear();
+        mCompleted.clear();
+        mCpuTierBudget = 256 * 1024 * 1024;
+        mHeldEncodedBytes = 0;
+        mEncodedTier.setBudget( mCpuTierBudget );
+        mPrefetched.setBudget( 256 * 1024 * 1024 );
+        mDecoding = 0;
+        mActive = 0;
+        mPaused = false;
+        mThrottle = LoadThrottle( mPool->getThreadCount() );
+        // start taking jobs
+        mPool->addClient( this );
+    }
+
+    SurfaceStore::~SurfaceStore(){
+        // stop taking jobs and wait for the ones that are running, the pool threads carry on for other stores
+        mPool->removeClient( this );
+        // clear buffers
+        mCompleted.clear();
+        mPrefetched.clear();
+        mSurfaceRefs.clear();
+        mEncodedRefs.clear();
+        mEncodedTier.clear();
+        mProbed.clear();
+        mRequested.clear();
+        mQueue.clear();
+    }
+
+    void SurfaceStore::addSearchPath(const ci::fs::path &path){
+        std::unique_lock<std::mutex> lock( mPathMutex );
+        mSearchPaths.push_back( path );
+    }
+
+    void SurfaceStore::setPathResolver(const std::function<ci::fs::path (const std::string &)> &resolver){
+        std::unique_lock<std::mutex> lock( mPathMutex );
+        mPathResolver = resolver;
+    }
+
+    std::vector<std::string> SurfaceStore::listImageDirectory(const ci::fs::path &path){
+        std::vector<std::string> pathsToLoad;
+
+        ci::fs::path dir = path;
+        if( !ci::fs::exists( dir ) ){
+            std::unique_lock<std::mutex> lock( mPathMutex );
+            for( auto &searchPath : mSearchPaths ){
+                if( ci::fs::exists( searchPath / path ) ){
+                    dir = searchPath / path;
+                    break;
+                }
+            }
+        }
+        if( !ci::fs::exists( dir ) ){
+            CI_LOG_E( "rph::SurfaceStore::listImageDirectory - ERROR - (" << path << ") Folder does not Exist!" );
+            return pathsToLoad;
+        }
+
+        for ( ci::fs::directory_iterator it( dir ); it != ci::fs::directory_iterator(); ++it ){
+            if ( ci::fs::is_regular_file( *it ) && hasValidFileExtension( it->path().extension() ) ){
+                pathsToLoad.push_back( it->path().string() );
+            }
+        }
+        sort( pathsToLoad.begin(), pathsToLoad.end() ); // sort alphabetically
+        if( mWatcher ) mWatcher->watch( dir );
+        return pathsToLoad;
+    }
+
+    std::vector<ci::SurfaceRef> SurfaceStore::loadImageDirectory(const ci::fs::path &dir){
+        std::vector<std::string> pathsToLoad = listImageDirectory( dir );
+        std::vector<ci::SurfaceRef> surfaceRefs( pathsToLoad.size() );
+
+        // the stored ones are done, the others get decoded as a batch
+        std::vector<uint32_t> urlIds;
+        std::vector<size_t> indices;
+        for( size_t i = 0; i < pathsToLoad.size(); ++i ){
+            uint32_t urlId = mKeys.internUrl( pathsToLoad[i] );
+            mAccessManifest.record( urlId );
+            auto existing = mSurfaceRefs.find( urlId );
+            if( existing != mSurfaceRefs.end() ){
+                surfaceRefs[i] = existing->second;
+            } else {
+                urlIds.push_back( urlId );
+                indices.push_back( i );
+            }
+        }
+        decodeBatch( urlIds, [&]( size_t index, const DecodedImage &decoded ){
+            surfaceRefs[ indices[index] ] = storeSurface( urlIds[index], decoded );
+        } );
+        return surfaceRefs;
+    }
+
+    ci::SurfaceRef SurfaceStore::load(const std::string &url){
+        uint32_t urlId = mKeys.internUrl( url );
+        mAccessManifest.record( urlId );
+
+        // if surface already exists, return it immediately
+        auto existing = mSurfaceRefs.find( urlId );
+        if( existing != mSurfaceRefs.end() )
+            return existing->second;
+
+        // otherwise, check if the image has loaded in the background, or load it right here
+        DecodedImage decoded;
+        if( tryTake( urlId, decoded ) || decode( urlId, decoded ) )
+            return storeSurface( urlId, decoded );
+
+        CI_LOG_E( "error loading surface '" << url << "'!" );
+        return ci::SurfaceRef();
+    }
+
+    ci::SurfaceRef SurfaceStore::fetch(const std::string &url){
+        uint32_t urlId = mKeys.internUrl( url );
+        mAccessManifest.record( urlId );
+
+        // if surface already exists, return it immediately
+        auto existing = mSurfaceRefs.find( urlId );
+        if( existing != mSurfaceRefs.end() )
+            return existing->second;
+
+        // otherwise, check if the image has loaded
+        DecodedImage decoded;
+        if( tryTake( urlId, decoded ) )
+            return storeSurface( urlId, decoded );
+
+        request( urlId );
+        return ci::SurfaceRef();
+    }
+
+    bool SurfaceStore::isLoading(const std::string &url){
+        return isRequested( mKeys.internUrl( url ) );
+    }
+
+    bool SurfaceStore::isLoaded(const std::string &url){
+        return mSurfaceRefs.find( mKeys.internUrl( url ) ) != mSurfaceRefs.end();
+    }
+
+    ImageInfo SurfaceStore::probe(const std::string &url){
+        uint32_t urlId = mKeys.internUrl( url );
+        ImageInfo info;
+        if( findProbed( urlId, info ) ) return info;
+        // a single header is quicker to read right here than to hand over to the loader threads
+        return probeHeader( urlId );
+    }
+
+    std::vector<ImageInfo> SurfaceStore::probeDirectory(const ci::fs::path &dir){
+        std::vector<std::string> paths = listImageDirectory( dir );
+        std::vector<uint32_t> urlIds;
+        std::vector<ImageInfo> infos( paths.size() );
+
+        // queue everything that hasn't been probed yet, under a single lock of the queue each
+        for( const std::string &path : paths ){
+            urlIds.push_back( mKeys.internUrl( path ) );
+            ImageInfo info;
+            if( !findProbed( urlIds.back(), info ) ) mQueue.push( Job{ urlIds.back(), Job::PROBE }, PROBE_PRIORITY );
+        }
+        mPool->notify();
+
+        // help out from the back while the loader threads work from the front. Doing our share here also
+        // means this can't stall on loader threads that are waiting for the main thread to take their images.
+        for( size_t i = urlIds.size(); i-- > 0; ){
+            if( mQueue.erase( Job{ urlIds[i], Job::PROBE } ) ) probeHeader( urlIds[i] );
+        }
+
+        // wait for the ones the loader threads are still on
+        std::unique_lock<std::mutex> lock( mProbeMutex );
+        for( size_t i = 0; i < urlIds.size(); ++i ){
+            auto itr = mProbed.end();
+            mProbeCondition.wait( lock, [&](){ return ( itr = mProbed.find( urlIds[i] ) ) != mProbed.end(); } );
+            infos[i] = itr->second;
+        }
+        return infos;
+    }
+
+    bool SurfaceStore::findProbed(uint32_t urlId, ImageInfo &info){
+        std::unique_lock<std::mutex> lock( mProbeMutex );
+        auto itr = mProbed.find( urlId );
+        if( itr == mProbed.end() ) return false;
+        info = itr->second;
+        return true;
+    }
+
+    ImageInfo SurfaceStore::probeHeader(uint32_t urlId){
+        const std::string url = mKeys.getUrl( urlId );
+        ImageInfo info;
+        {
+            RPH_STATS_SCOPE( mLoadStats, LoadStage::PROBE, url );
+
+            // the cpu tier may still have the whole file, otherwise read just the header from disk.
+            // Peek, a probe is no use of the image and shouldn't show in the tier's hit ratio or eviction order.
+            ci::BufferRef encoded;
+            if( mEncodedTier.peek( urlId, encoded ) ){
+                info = probeImage( encoded->getData(), encoded->getSize() );
+            } else if( ci::DataSourceRef source = resolveSource( url ) ){
+                try {
+                    if( source->isFilePath() ) {
+                        info = probeImageFile( source->getFilePath().string() );
+                    } else {
+                        // online images have to be downloaded anyway
+                        encoded = source->getBuffer();
+                        if( encoded ) info = probeImage( encoded->getData(), encoded->getSize() );
+                    }
+                } catch(...) {}
+            }
+        }
+
+        std::unique_lock<std::mutex> lock( mProbeMutex );
+        mProbed[ urlId ] = info;
+        lock.unlock();
+        mProbeCondition.notify_all();
+        return info;
+    }
+
+    ci::SurfaceRef SurfaceStore::storeSurface(uint32_t urlId, const DecodedImage &decoded){
+        mSurfaceRefs[ urlId ] = decoded.surface;
+        if( holdEncoded( decoded.encoded ) ){
+            mEncodedRefs[ urlId ] = decoded.encoded;
+        }
+        return decoded.surface;
+    }
+
+    void SurfaceStore::garbageCollect(){
+        RPH_STATS_SCOPE( mLoadStats, LoadStage::GARBAGE_COLLECT );
+        for( auto itr = mSurfaceRefs.begin(); itr != mSurfaceRefs.end(); ){
+            if( itr->second.use_count() < 2 ){
+                auto encoded = mEncodedRefs.find( itr->first );
+                if( encoded != mEncodedRefs.end() ){
+                    demote( itr->first, encoded->second );
+                    mEncodedRefs.erase( encoded );
+                }
+                mSurfaceRefs.erase( itr++ );
+            } else {
+                ++itr;
+            }
+        }
+    }
+
+    void SurfaceStore::setWatchingDirectories(bool watching){
+        if( watching && !mWatcher ) mWatcher = DirectoryWatcher::create();
+        else if( !watching ) mWatcher.reset();
+    }
+
+    std::vector<DirectoryWatcher::Change> SurfaceStore::updateWatched(){
+        std::vector<DirectoryWatcher::Change> changes;
+        if( !mWatcher ) return changes;
+
+        for( const DirectoryWatcher::Change &change : mWatcher->takeChanges() ){
+            if( !hasValidFileExtension( ci::fs::path( change.path ).extension() ) ) continue;
+            changes.push_back( change );
+
+            // nothing is cached for a url that was never asked for
+            const uint32_t urlId = mKeys.findUrl( change.path );
+            if( urlId == TextureKey::INVALID_ID ) continue;
+
+            // decodes of the old version that are in flight get done again, see processJob()
+            {
+                std::unique_lock<std::mutex> lock( mVersionMutex );
+                mFileVersions[ urlId ]++;
+            }
+
+            // drop the copies of the old version, including the bytes held to demote the stored surface later
+            mEncodedTier.erase( urlId );
+            mLentEncoded.erase( urlId );
+            auto encoded = mEncodedRefs.find( urlId );
+            if( encoded != mEncodedRefs.end() ){
+                releaseEncoded( encoded->second );
+                mEncodedRefs.erase( encoded );
+            }
+            {
+                std::unique_lock<std::mutex> lock( mProbeMutex );
+                mProbed.erase( urlId );
+            }
+
+            // a decode waiting to be taken, or a prefetched one a request was going to be served from, is done again
+            const bool completed = mCompleted.erase( urlId );
+            const bool prefetched = mPrefetched.erase( urlId );
+            if( ( completed || prefetched ) && isRequested( urlId ) ){
+                mQueue.push( Job{ urlId, Job::DECODE }, REQUEST_PRIORITY );
+                mPool->notify();
+            }
+
+            if( change.type == DirectoryWatcher::Change::MODIFIED && mSurfaceRefs.find( urlId ) != mSurfaceRefs.end() )
+                reload( urlId );
+        }
+        return changes;
+    }
+
+    bool SurfaceStore::reload(uint32_t urlId){
+        mEncodedTier.erase( urlId );
+        if( !mQueue.push( Job{ urlId, Job::RELOAD }, REQUEST_PRIORITY ) ) return false;
+        mPool->notify();
+        return true;
+    }
+
+    std::vector<SurfaceStore::ReloadedImage> SurfaceStore::takeReloaded(){
+        std::vector<ReloadedImage> reloaded;
+        ReloadedImage image;
+        while( mReloaded.try_pop( image ) ){
+            auto existing = mSurfaceRefs.find( image.urlId );
+            if( existing != mSurfaceRefs.end() ){
+                // deep copy into the surface everyone holds
+                *existing->second = *image.decoded.surface;
+                // the bytes of the old version were dropped by updateWatched()
+                auto encoded = mEncodedRefs.find( image.urlId );
+                if( encoded != mEncodedRefs.end() ){
+                    releaseEncoded( encoded->second );
+                    mEncodedRefs.erase( encoded );
+                }
+                if( holdEncoded( image.decoded.encoded ) ) mEncodedRefs[ image.urlId ] = image.decoded.encoded;
+            }
+            reloaded.push_back( image );
+        }
+        return reloaded;
+    }
+
+    bool SurfaceStore::request(uint32_t urlId){
+        // add to list of currently loading/scheduled files
+        {
+            std::unique_lock<std::mutex> lock( mRequestedMutex );
+            if( !mRequested.insert( urlId ).second ) return false;
+        }
+        // decoded ahead of time already, pin it where tryTake() hands it over
+        DecodedImage decoded;
+        if( mPrefetched.take( urlId, decoded ) ){
+            mCompleted.push( urlId, decoded );
+            return true;
+        }
+        // hand over to threaded loader, moving it to the front if it was queued as a prefetch
+        mQueue.push( Job{ urlId, Job::DECODE }, REQUEST_PRIORITY );
+        mPool->notify();
+        return true;
+    }
+
+    LoadBatchRef SurfaceStore::request(const std::vector<uint32_t> &urlIds){
+        {
+            std::unique_lock<std::mutex> lock( mRequestedMutex );
+            mRequested.insert( urlIds.begin(), urlIds.end() );
+        }
+        return queueBatch( urlIds, REQUEST_PRIORITY, urlIds.size() );
+    }
+
+    LoadBatchRef SurfaceStore::prefetch(const std::vector<std::string> &urls, int priority){
+        std::vector<uint32_t> urlIds;
+        urlIds.reserve( urls.size() );
+        for( const std::string &url : urls ){
+            uint32_t urlId = mKeys.internUrl( url );
+            // stored surfaces are done already
+            if( mSurfaceRefs.find( urlId ) == mSurfaceRefs.end() ) urlIds.push_back( urlId );
+        }
+        return queueBatch( urlIds, std::min( priority, REQUEST_PRIORITY - 1 ), urls.size() );
+    }
+
+    LoadBatchRef SurfaceStore::queueBatch(const std::vector<uint32_t> &urlIds, int priority, size_t count){
+        // images that are decoded and waiting to be taken are done. Requested ones are pinned where tryTake()
+        // hands them over, prefetched ones stay put as nothing gets dropped from the prefetch budget to make room.
+        const bool isRequest = priority >= REQUEST_PRIORITY;
+        std::vector<uint32_t> pending;
+        std::vector<Job> jobs;
+        pending.reserve( urlIds.size() );
+        jobs.reserve( urlIds.size() );
+        for( uint32_t urlId : urlIds ){
+            DecodedImage decoded;
+            if( isRequest && mPrefetched.take( urlId, decoded ) ) mCompleted.push( urlId, decoded );
+            if( mPrefetched.contains( urlId ) || mCompleted.contains( urlId ) ) continue;
+            pending.push_back( urlId );
+            jobs.push_back( Job{ urlId, Job::DECODE } );
+        }
+
+        // listen for the results before the jobs can finish, then queue them all under a single lock
+        LoadBatchRef batch = LoadBatch::create( pending, count );
+        if( !pending.empty() ){
+            {
+                std::unique_lock<std::mutex> lock( mBatchMutex );
+                mBatches.push_back( batch );
+            }
+            mQueue.push( jobs.begin(), jobs.end(), priority );
+            mPool->notify();
+        }
+        return batch;
+    }
+
+    void SurfaceStore::finishBatches(uint32_t urlId){
+        std::unique_lock<std::mutex> lock( mBatchMutex );
+        for( auto itr = mBatches.begin(); itr != mBatches.end(); ){
+            LoadBatchRef batch = itr->lock();
+            if( batch ) batch->finish( urlId );
+            // nobody waits for a batch that is done or has been let go of
+            if( !batch || batch->isDone() ) itr = mBatches.erase( itr );
+            else ++itr;
+        }
+    }
+
+    void SurfaceStore::decodeBatch(const std::vector<uint32_t> &urlIds, const std::function<void (size_t, const DecodedImage &)> &handler){
+        LoadBatchRef batch = request( urlIds );
+        std::vector<bool> handled( urlIds.size(), false );
+        std::unordered_map<uint32_t, size_t> indices;
+        size_t remaining = urlIds.size();
+
+        // hands over an image the pool is done with, one that can't be taken failed
+        auto take = [&]( size_t i ){
+            DecodedImage decoded;
+            if( tryTake( urlIds[i], decoded ) ) handler( i, decoded );
+            else CI_LOG_E( "error loading surface '" << mKeys.getUrl( urlIds[i] ) << "'!" );
+            handled[i] = true;
+            remaining--;
+        };
+
+        // the ones that were decoded already never show up as finished
+        for( size_t i = 0; i < urlIds.size(); ++i ){
+            indices[ urlIds[i] ] = i;
+            if( !batch->isPending( urlIds[i] ) ) take( i );
+        }
+
+        // both cursors only move forward, so every image is looked at a bounded number of times
+        size_t finished = 0;
+        size_t back = urlIds.size();
+        while( remaining > 0 ){
+            // read before looking, so whatever finishes from here on wakes us up below
+            const size_t doneCount = batch->getDoneCount();
+
+            // hand over what the pool has finished since the last round
+            for( uint32_t urlId : batch->getFinished( finished ) ){
+                finished++;
+                const size_t i = indices[ urlId ];
+                if( !handled[i] ) take( i );
+            }
+            if( remaining == 0 ) break;
+
+            // help out from the back while the pool works from the front, which also keeps this from
+            // stalling on a pool that is paused or waiting for other images to be taken
+            bool helped = false;
+            while( back > 0 && !helped ){
+                const size_t i = --back;
+                if( handled[i] || !mQueue.erase( Job{ urlIds[i], Job::DECODE } ) ) continue;
+                DecodedImage decoded;
+                if( decode( urlIds[i], decoded ) ){
+                    {
+                        std::unique_lock<std::mutex> lock( mRequestedMutex );
+                        mRequested.erase( urlIds[i] );
+                    }
+                    handler( i, decoded );
+                } else {
+                    CI_LOG_E( "error loading surface '" << mKeys.getUrl( urlIds[i] ) << "'!" );
+                }
+                finishBatches( urlIds[i] );
+                handled[i] = true;
+                remaining--;
+                helped = true;
+            }
+
+            // nothing left to help with, wait for the pool
+            if( !helped ) batch->waitForMore( doneCount );
+        }
+    }
+
+    bool SurfaceStore::prefetch(uint32_t urlId, int priority){
+        if( mSurfaceRefs.find( urlId ) != mSurfaceRefs.end() || isRequested( urlId ) || mPrefetched.contains( urlId ) )
+            return false;
+        if( !mQueue.push( Job{ urlId, Job::DECODE }, std::min( priority, REQUEST_PRIORITY - 1 ) ) ) return false;
+        mPool->notify();
+        return true;
+    }
+
+    int SurfaceStore::prefetchAccessManifest(const std::string &path, size_t maxCount){
+        std::vector<AccessManifest::Entry> entries = AccessManifest::load( path );
+        if( maxCount > 0 && entries.size() > maxCount ) entries.resize( maxCount );
+
+        // entries come in prefetch order, hand out descending priorities to keep it
+        int queued = 0;
+        for( size_t i = 0; i < entries.size(); ++i ){
+            if( prefetch( mKeys.internUrl( entries[i].url ), int( entries.size() - i ) ) ) queued++;
+        }
+        CI_LOG_I( "prefetching " << queued << " of " << entries.size() << " images from '" << path << "'" );
+        return queued;
+    }
+
+    void SurfaceStore::cancel(uint32_t urlId){
+        {
+            std::unique_lock<std::mutex> lock( mRequestedMutex );
+            if( mRequested.erase( urlId ) == 0 ) return;
+        }
+        // nobody waits for it anymore
+        mLentEncoded.erase( urlId );
+        if( mQueue.erase( Job{ urlId, Job::DECODE } ) ) finishBatches( urlId );
+
+        // an image waiting to be taken would hold the pool back for good, see hasJob()
+        DecodedImage decoded;
+        if( mCompleted.try_pop( urlId, decoded ) ){
+            parkPrefetched( urlId, decoded );
+            mPool->notify();
+        }
+    }
+
+    bool SurfaceStore::isRequested(uint32_t urlId){
+        std::unique_lock<std::mutex> lock( mRequestedMutex );
+        return mRequested.find( urlId ) != mRequested.end();
+    }
+
+    bool SurfaceStore::tryTake(uint32_t urlId, DecodedImage &decoded){
+        if( mCompleted.try_pop( urlId, decoded ) ) {
+            // done loading, which may let the pool run ahead again
+            {
+                std::unique_lock<std::mutex> lock( mRequestedMutex );
+                mRequested.erase( urlId );
+            }
+            mLentEncoded.erase( urlId );
+            mPool->notify();
+            return true;
+        }
+        if( mPrefetched.take( urlId, decoded ) ) {
+            {
+                std::unique_lock<std::mutex> lock( mRequestedMutex );
+                mRequested.erase( urlId );
+            }
+            // decoded before the bytes were lent, they aren't needed anymore
+            mLentEncoded.erase( urlId );
+            return true;
+        }
+        return false;
+    }
+
+    bool SurfaceStore::parkPrefetched(uint32_t urlId, const DecodedImage &decoded){
+        // nothing is dropped to make room, so the images prefetched first are there when they are asked for
+        return mPrefetched.putIfFits( urlId, decoded, size_t( decoded.surface->getRowBytes() ) * decoded.surface->getHeight() );
+    }
+
+    bool SurfaceStore::holdEncoded(const ci::BufferRef &encoded){
+        if( !encoded ) return false;
+        std::unique_lock<std::mutex> lock( mTierMutex );
+        if( mHeldEncodedBytes + encoded->getSize() > mCpuTierBudget ) return false;
+        // the least recently evicted images make room
+        mHeldEncodedBytes += encoded->getSize();
+        mEncodedTier.setBudget( mCpuTierBudget - mHeldEncodedBytes );
+        return true;
+    }
+
+    void SurfaceStore::releaseEncoded(const ci::BufferRef &encoded){
+        if( !encoded ) return;
+        std::unique_lock<std::mutex> lock( mTierMutex );
+        mHeldEncodedBytes -= std::min( mHeldEncodedBytes, encoded->getSize() );
+        mEncodedTier.setBudget( mCpuTierBudget - std::min( mCpuTierBudget, mHeldEncodedBytes ) );
+    }
+
+    void SurfaceStore::demote(uint32_t urlId, const ci::BufferRef &encoded){
+        releaseEncoded( encoded );
+        if( encoded ) mEncodedTier.put( urlId, encoded, encoded->getSize() );
+    }
+
+    void SurfaceStore::lendEncoded(uint32_t urlId, const ci::BufferRef &encoded){
+        if( encoded ) mLentEncoded.push( urlId, encoded );
+    }
+
+    void SurfaceStore::setCpuTierBudget(size_t bytes){
+        if( bytes == 0 ){
+            // nothing is held for the stored surfaces anymore
+            for( auto &encoded : mEncodedRefs ) releaseEncoded( encoded.second );
+            mEncodedRefs.clear();
+        }
+        std::unique_lock<std::mutex> lock( mTierMutex );
+        mCpuTierBudget = bytes;
+        mEncodedTier.setBudget( mCpuTierBudget - std::min( mCpuTierBudget, mHeldEncodedBytes ) );
+    }
+
+    size_t SurfaceStore::getCpuTierBudget() const {
+        std::unique_lock<std::mutex> lock( mTierMutex );
+        return mCpuTierBudget;
+    }
+
+    size_t SurfaceStore::getCpuTierBytes() const {
+        std::unique_lock<std::mutex> lock( mTierMutex );
+        return mHeldEncodedBytes + mEncodedTier.getBytes();
+    }
+
+    bool SurfaceStore::decode(uint32_t urlId, DecodedImage &decoded){
+        const std::string url = mKeys.getUrl( urlId );
+        if( !readEncoded( urlId, url, decoded.encoded ) ) return false;
+
+        try {
+            decoded.surface = convertImage( url, decodeImage( url, decoded.encoded ) );
+            return true;
+        } catch(...) {}
+
+        return false;
+    }
+
+    ci::DataSourceRef SurfaceStore::resolveSource(const std::string &url)
+    {
+        RPH_STATS_SCOPE( mLoadStats, LoadStage::RESOLVE, url );
+
+        // try to load from FILE (fast)
+        if( ci::fs::exists( url ) ) return ci::loadFile( url );
+
+        {
+            std::unique_lock<std::mutex> lock( mPathMutex );
+
+            // try the resolver, the TextureStore uses it to find ASSETS (fast)
+            if( mPathResolver ){
+                ci::fs::path resolved = mPathResolver( url );
+                if( !resolved.empty() ) return ci::loadFile( resolved );
+            }
+
+            // try the search paths (fast)
+            for( auto &searchPath : mSearchPaths ){
+                if( ci::fs::exists( searchPath / url ) ) return ci::loadFile( searchPath / url );
+            }
+        }
+
+        // try to load from URL (slow)
+        try {
+            return ci::loadUrl( ci::Url(url) );
+        } catch(...) {}
+
+        return ci::DataSourceRef();
+    }
+
+    bool SurfaceStore::readEncoded(uint32_t urlId, const std::string &url, ci::BufferRef &encoded)
+    {
+        // use the bytes another format of the image holds on to
+        if( mLentEncoded.try_pop( urlId, encoded ) ) return true;
+
+        // restore from the cpu tier if the image has been evicted recently (fastest)
+        if( mEncodedTier.take( urlId, encoded ) ) return true;
+
+        ci::DataSourceRef source = resolveSource( url );
+        if( !source ) return false;
+
+        RPH_STATS_SCOPE( mLoadStats, LoadStage::READ, url );
+        try {
+            encoded = source->getBuffer();
+            return bool( encoded );
+        } catch(...) {}
+
+        return false;
+    }
+
+    ci::ImageSourceRef SurfaceStore::decodeImage(const std::string &url, const ci::BufferRef &encoded)
+    {
+        RPH_STATS_SCOPE( mLoadStats, LoadStage::DECODE, url );
+
+        // the buffer has no file name, so pass the extension along to pick the right decoder
+        std::string extension = ci::fs::path( url ).extension().string();
+        if( !extension.empty() && extension[0] == '.' ) extension.erase( 0, 1 );
+
+        return ci::loadImage( ci::DataSourceBuffer::create( encoded ), ci::ImageSource::Options(), extension );
+    }
+
+    ci::SurfaceRef SurfaceStore::convertImage(const std::string &url, const ci::ImageSourceRef &image)
+    {
+        RPH_STATS_SCOPE( mLoadStats, LoadStage::CONVERT, url );
+
+        ci::SurfaceRef surface = ci::Surface::create( image );
+        RPH_STATS( mLoadStats.addBytesDecoded( uint64_t( surface->getRowBytes() ) * surface->getHeight() ) );
+        return surface;
+    }
+
+    bool SurfaceStore::hasJob(){
+        // don't run further ahead of the consumer than MAX_COMPLETED, tryTake() wakes the pool up again
+        if( mQueue.empty() || mCompleted.size() > MAX_COMPLETED ) return false;
+        // there may be fewer slots than pool threads while throttled, and none while paused
+        std::unique_lock<std::mutex> lock( mGateMutex );
+        return !mPaused && mActive < mThrottle.getDecoders();
+    }
+
+    bool SurfaceStore::runJob(){
+        {
+            // another pool thread may have taken the last slot since hasJob()
+            std::unique_lock<std::mutex> lock( mGateMutex );
+            if( mPaused || mActive >= mThrottle.getDecoders() ) return false;
+            mActive++;
+        }
+        Job job;
+        int priority;
+        bool popped = mQueue.try_pop( job, &priority );
+        bool done = popped && processJob( job, priority );
+        if( done && job.type == Job::DECODE ) finishBatches( job.urlId );
+
+        std::unique_lock<std::mutex> lock( mGateMutex );
+        mActive--;
+        return popped;
+    }
+
+    bool SurfaceStore::processJob(const Job &job, int priority)
+    {
+        if( job.type == Job::PROBE ) {
+            probeHeader( job.urlId );
+            return true;
+        }
+        const uint32_t urlId = job.urlId;
+        const uint32_t version = getFileVersion( urlId );
+        if( job.type == Job::RELOAD ) {
+            ReloadedImage image;
+            image.urlId = urlId;
+            mDecoding++;
+            bool success = decode( urlId, image.decoded );
+            mDecoding--;
+            if( getFileVersion( urlId ) != version ) return redo( job, priority );
+            if( success ) mReloaded.push( image );
+            return true;
+        }
+
+        // skip prefetches once the prefetch budget is full, the earlier ones are needed first and stay
+        bool isPrefetch = priority < REQUEST_PRIORITY && !isRequested( urlId );
+        if( isPrefetch && mPrefetched.getBytes() >= mPrefetched.getBudget() ) return true;
+
+        // images that can't be found or decoded stay in the loading queue, so they aren't retried every frame
+        DecodedImage decoded;
+        mDecoding++;
+        bool success = decode( urlId, decoded );
+        mDecoding--;
+        // the file changed on disk while it was read
+        if( getFileVersion( urlId ) != version ) return redo( job, priority );
+        if( !success ) return true;
+
+        if( !isRequested( urlId ) ) {
+            // park it until it gets asked for, which includes requests that were cancelled while it decoded
+            parkPrefetched( urlId, decoded );
+        } else {
+            // copy to main thread
+            mCompleted.push( urlId, decoded );
+        }
+        return true;
+    }
+
+    bool SurfaceStore::redo(const Job &job, int priority)
+    {
+        mQueue.push( job, priority );
+        mPool->notify();
+        return false;
+    }
+
+    uint32_t SurfaceStore::getFileVersion(uint32_t urlId)
+    {
+        std::unique_lock<std::mutex> lock( mVersionMutex );
+        auto itr = mFileVersions.find( urlId );
+        return ( itr != mFileVersions.end() ) ? itr->second : 0;
+    }
+
+    void SurfaceStore::pause(){
+        std::unique_lock<std::mutex> lock( mGateMutex );
+        mPaused = true;
+    }
+
+    void SurfaceStore::resume(){
+        std::unique_lock<std::mutex> lock( mGateMutex );
+        mPaused = false;
+        lock.unlock();
+        mPool->notify();
+    }
+
+    bool SurfaceStore::isPaused(){
+        std::unique_lock<std::mutex> lock( mGateMutex );
+        return mPaused;
+    }
+
+    bool SurfaceStore::addFrameTime(double seconds){
+        std::unique_lock<std::mutex> lock( mGateMutex );
+        if( !mThrottle.addFrameTime( seconds ) ) return false;
+        lock.unlock();
+        // more slots may have opened up
+        mPool->notify();
+        return true;
+    }
+
+    void SurfaceStore::setTargetFrameTime(double seconds){
+        std::unique_lock<std::mutex> lock( mGateMutex );
+        mThrottle.setTargetFrameTime( seconds );
+    }
+
+    LoadThrottle SurfaceStore::getThrottle(){
+        std::unique_lock<std::mutex> lock( mGateMutex );
+        return mThrottle;
+    }
+
+    bool SurfaceStore::hasValidFileExtension(const ci::fs::path &extension){
+        for(auto itr = validFileExtension.begin(); itr != validFileExtension.end(); itr++){
+            if( extension == (*itr) ){
+                return true;
+            }
+        }
+        return false;
+    }
+
+    LoadStats::Summary SurfaceStore::getStats(){
+        LoadStats::Summary summary = mLoadStats.getSummary();
+        summary.queueDepth = mQueue.size();
+        summary.inFlight = mDecoding;
+        summary.cpuTier = getCpuTierStats();
+        summary.cpuTierBytes = getCpuTierBytes();
+        for( auto itr = mSurfaceRefs.begin(); itr != mSurfaceRefs.end(); ++itr ){
+            summary.bytesResident += uint64_t( itr->second->getRowBytes() ) * itr->second->getHeight();
+        }
+        return summary;
+    }
+
+} // namespace rph
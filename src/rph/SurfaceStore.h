@@ -0,0 +1,318 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ SurfaceStore is based on work by Paul Houx
+ Copyright (c) 2010-2012, Paul Houx - All rights reserved.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include "cinder/Buffer.h"
+#include "cinder/DataSource.h"
+#include "cinder/Filesystem.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Surface.h"
+#include "cinder/Thread.h"
+
+#include "rph/AccessManifest.h"
+#include "rph/ConcurrentMap.h"
+#include "rph/ConcurrentPriorityQueue.h"
+#include "rph/ConcurrentQueue.h"
+#include "rph/DecodePool.h"
+#include "rph/DirectoryWatcher.h"
+#include "rph/ImageProbe.h"
+#include "rph/KeyRegistry.h"
+#include "rph/LoadBatch.h"
+#include "rph/LoadStats.h"
+#include "rph/LoadThrottle.h"
+#include "rph/LruCache.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace rph {
+
+    typedef std::shared_ptr<class SurfaceStore> SurfaceStoreRef;
+
+    //! resolves, reads and decodes images on background threads and caches them as Surfaces.
+    //! Needs neither a GL context nor ci::app, so it runs in offline tools and on servers without a GPU.
+    //! TextureStore is a thin GL layer on top of it.
+    class SurfaceStore : public DecodePool::Client {
+      public:
+        //! a decoded image along with the bytes it was decoded from
+        struct DecodedImage {
+            ci::SurfaceRef  surface;
+            ci::BufferRef   encoded;
+        };
+
+        //! images that have been asked for queue at this priority, prefetches always queue behind them
+        static const int REQUEST_PRIORITY = 1 << 30;
+        //! probes only read a few kilobytes, they go ahead of everything else
+        static const int PROBE_PRIORITY = REQUEST_PRIORITY + 1;
+
+        //! a unit of work for the loader threads
+        struct Job {
+            enum Type { DECODE, PROBE, RELOAD };
+
+            uint32_t    urlId;
+            Type        type;
+
+            bool operator==( const Job &rhs ) const { return urlId == rhs.urlId && type == rhs.type; }
+
+            //! for the queue, std::hash can't be specialized for a nested type before the queue is declared
+            struct Hash {
+                size_t operator()( const Job &job ) const { return std::hash<uint64_t>()( ( uint64_t( job.type ) << 32 ) | job.urlId ); }
+            };
+        };
+
+        //! a new version of an image that changed on disk
+        struct ReloadedImage {
+            uint32_t        urlId;
+            DecodedImage    decoded;
+        };
+
+        //! a store with its own loader threads
+        static SurfaceStoreRef create( int numThreads = 1 ) { return create( DecodePool::create( numThreads ) ); }
+        //! a store that shares the threads of a pool with other stores, each keeping its own caches and budgets
+        static SurfaceStoreRef create( const DecodePoolRef &pool ) { return SurfaceStoreRef( new SurfaceStore( pool ) ); }
+        ~SurfaceStore();
+
+        //! interned urls, shared with the layers on top so every url has a single id
+        KeyRegistry&        getKeys() { return mKeys; }
+        uint32_t            getUrlId(const std::string &url) { return mKeys.internUrl(url); }
+
+        //! relative urls and directories are looked up in these, in order, when they don't exist as given
+        void                addSearchPath(const ci::fs::path &path);
+        //! maps a relative url to a full path, or an empty path if it can't find it. Tried before the search paths.
+        void                setPathResolver(const std::function<ci::fs::path (const std::string &)> &resolver);
+
+        //! returns the sorted image files in a directory, or nothing if it doesn't exist
+        std::vector<std::string> listImageDirectory(const ci::fs::path &dir);
+        //! synchronously loads all images of a directory, decoding them on the pool and the calling thread at once
+        std::vector<ci::SurfaceRef> loadImageDirectory(const ci::fs::path &dir);
+
+        //! synchronously loads an image into a surface, stores it and returns it
+        ci::SurfaceRef      load(const std::string &url);
+        //! asynchronously loads an image into a surface, returns NULL until it is ready
+        ci::SurfaceRef      fetch(const std::string &url);
+
+        bool                isLoading(const std::string &url);
+        bool                isLoaded(const std::string &url);
+
+        //! reads the dimensions and channel count of an image from its file header without decoding it.
+        //! Results are cached, an image that can't be found or isn't a JPEG or PNG returns an invalid ImageInfo.
+        //! Blocks while it reads the header on the calling thread, use probeDirectory() for many images at once.
+        ImageInfo           probe(const std::string &url);
+        //! probes all images of a directory on the loader threads, in the order of listImageDirectory()
+        std::vector<ImageInfo> probeDirectory(const ci::fs::path &dir);
+
+        //! removes Surfaces from memory if no longer in use
+        void                garbageCollect();
+        int                 getSurfaceRefsCount() const { return int(mSurfaceRefs.size()); }
+
+        // pipeline access for the layers on top:
+
+        //! queues an image for decoding, returns false if it already is queued or decoded
+        bool                request(uint32_t urlId);
+        //! queues an image for decoding ahead of time behind the requested ones, returns false if it
+        //! already is queued or decoded. Prefetched images wait in the prefetch budget until they are asked for,
+        //! request() then moves them out of it so they can't be dropped before they are taken.
+        bool                prefetch(uint32_t urlId, int priority = 0);
+        //! queues a batch of images at once, under a single lock of the queue, in the order given
+        LoadBatchRef        request(const std::vector<uint32_t> &urlIds);
+        LoadBatchRef        prefetch(const std::vector<std::string> &urls, int priority = 0);
+        //! requests a batch of unique images and decodes it on the pool and the calling thread, returning once all
+        //! are done. The handler runs on the calling thread for every image as soon as it is decoded, so uploads
+        //! can overlap the decoding of the rest. Images that fail to load are logged and skipped.
+        void                decodeBatch(const std::vector<uint32_t> &urlIds, const std::function<void (size_t index, const DecodedImage &decoded)> &handler);
+        //! takes back a request that isn't needed anymore, e.g. a tile that went out of view. A queued image is
+        //! dropped, one that is decoded already waits in the prefetch budget, if it fits, in case it gets asked for again.
+        void                cancel(uint32_t urlId);
+        //! returns TRUE if an image has been requested and not taken yet
+        bool                isRequested(uint32_t urlId);
+        //! hands over a decoded image, returns false if it isn't ready yet
+        bool                tryTake(uint32_t urlId, DecodedImage &decoded);
+        //! resolves, reads and decodes an image on the calling thread
+        bool                decode(uint32_t urlId, DecodedImage &decoded);
+        //! counts the encoded bytes of a stored image against the cpu tier budget, so they can be demoted once it
+        //! gets evicted. Returns false if they don't fit, the image is then read from disk again after eviction.
+        bool                holdEncoded(const ci::BufferRef &encoded);
+        //! hands the bytes of holdEncoded() back to the budget without demoting them
+        void                releaseEncoded(const ci::BufferRef &encoded);
+        //! moves the held encoded bytes of an evicted image to the cpu tier
+        void                demote(uint32_t urlId, const ci::BufferRef &encoded);
+        //! offers encoded bytes that are in memory already, e.g. held for another format of the image, to its next
+        //! decode so it skips the disk. Dropped once the image is taken or its file changes.
+        void                lendEncoded(uint32_t urlId, const ci::BufferRef &encoded);
+
+        //! sets the byte budget of the cpu tier, which keeps the encoded bytes of recently evicted images in RAM
+        //! so loading them again skips the disk. The encoded bytes held for the stored images count against it too,
+        //! so the evicted ones get what the stored ones leave. A budget of 0 disables the tier.
+        void                setCpuTierBudget(size_t bytes);
+        size_t              getCpuTierBudget() const;
+        //! the held and the evicted encoded bytes
+        size_t              getCpuTierBytes() const;
+        int                 getCpuTierCount() const { return mEncodedTier.size(); }
+        CacheStats          getCpuTierStats() const { return mEncodedTier.getStats(); }
+
+        //! bytes of decoded images the prefetches may hold on to before they are asked for.
+        //! Nothing is dropped to make room: once it is full, further prefetches are skipped, so the ones queued
+        //! first are kept. A budget of 0 disables prefetching.
+        void                setPrefetchBudget(size_t bytes) { mPrefetched.setBudget( bytes ); }
+        size_t              getPrefetchBudget() const { return mPrefetched.getBudget(); }
+        size_t              getPrefetchBytes() const { return mPrefetched.getBytes(); }
+        int                 getPrefetchCount() const { return mPrefetched.size(); }
+
+        //! the access log for warm starts: record a session, save it, and prefetch it on the next launch
+        AccessManifest&     getAccessManifest() { return mAccessManifest; }
+        void                setRecordingAccesses(bool recording) { mAccessManifest.setRecording( recording ); }
+        void                recordAccess(uint32_t urlId) { mAccessManifest.record( urlId ); }
+        bool                saveAccessManifest(const std::string &path) const { return mAccessManifest.save( path, mKeys ); }
+        //! prefetches the images of a saved manifest in the order they were first asked for,
+        //! up to maxCount of them if it isn't 0. Returns the number of images queued.
+        int                 prefetchAccessManifest(const std::string &path, size_t maxCount = 0);
+
+        //! watches the directories listed from now on through listImageDirectory(), loadImageDirectory() and
+        //! probeDirectory(), and reloads the loaded images in them whose modification time or size changes
+        void                setWatchingDirectories(bool watching);
+        bool                isWatchingDirectories() const { return bool( mWatcher ); }
+        //! call regularly, e.g. once per frame. Picks up the changed image files of the watched directories,
+        //! drops the cached copies of their old versions and reloads the surfaces of this store in the background.
+        //! Decodes of a changed file that are queued, in flight or waiting to be taken come from the new version.
+        //! Returns the changes, so the layers on top can reload what they hold and report deletions.
+        std::vector<DirectoryWatcher::Change> updateWatched();
+        //! queues a changed image for decoding again, see takeReloaded()
+        bool                reload(uint32_t urlId);
+        //! hands over the images that have been reloaded. The surfaces of this store are updated in place,
+        //! so every SurfaceRef handed out earlier shows the new version.
+        std::vector<ReloadedImage> takeReloaded();
+
+        //! stops the loader threads from starting new work, e.g. during a scene transition. Work that has started finishes.
+        void                pause();
+        void                resume();
+        bool                isPaused();
+
+        //! feeds the time the last frame spent working into the throttle, which runs fewer decode threads and allows
+        //! fewer upload bytes per frame while frames run late, and more again once there is headroom. Leave out the
+        //! wait for vsync, a frame rate limited interval never shows headroom. Returns true if the limits changed.
+        //! Without any frame times the throttle stays at its maximum.
+        bool                addFrameTime(double seconds);
+        void                setTargetFrameTime(double seconds);
+        //! a copy of the throttle with its current limits
+        LoadThrottle        getThrottle();
+
+        DecodePoolRef       getDecodePool() const { return mPool; }
+
+        //! queue depth, stage latencies, bytes and cpu tier counters
+        LoadStats::Summary  getStats();
+        LoadStats&          getLoadStats() { return mLoadStats; }
+
+        std::vector<std::string> validFileExtension = {".png", ".jpg", ".jpeg"};
+
+      protected:
+        SurfaceStore( const DecodePoolRef &pool );
+        SurfaceStore( SurfaceStore const& );
+        SurfaceStore& operator=( SurfaceStore const& );
+
+        //! DecodePool::Client, the pool asks for work while this store has a slot free
+        bool hasJob() override;
+        bool runJob() override;
+        bool hasValidFileExtension(const ci::fs::path &extension);
+        //! finds a url on disk, through the path resolver, in the search paths or online
+        ci::DataSourceRef resolveSource(const std::string &url);
+        //! reads the encoded bytes for a url, restoring them from the cpu tier if possible
+        bool readEncoded(uint32_t urlId, const std::string &url, ci::BufferRef &encoded);
+        ci::ImageSourceRef decodeImage(const std::string &url, const ci::BufferRef &encoded);
+        ci::SurfaceRef convertImage(const std::string &url, const ci::ImageSourceRef &image);
+        //! returns false if the job has been queued again because its file changed while it ran
+        bool processJob(const Job &job, int priority);
+        bool redo(const Job &job, int priority);
+        uint32_t getFileVersion(uint32_t urlId);
+        //! queues the images of a batch of count images that aren't decoded yet
+        LoadBatchRef queueBatch(const std::vector<uint32_t> &urlIds, int priority, size_t count);
+        //! tells the waiting batches an image is done
+        void finishBatches(uint32_t urlId);
+        ci::SurfaceRef storeSurface(uint32_t urlId, const DecodedImage &decoded);
+        //! puts a decoded image nobody asked for in the prefetch budget, returns false if it doesn't fit
+        bool parkPrefetched(uint32_t urlId, const DecodedImage &decoded);
+        //! reads the header of an image and caches the result
+        ImageInfo probeHeader(uint32_t urlId);
+        bool findProbed(uint32_t urlId, ImageInfo &info);
+
+        //! the loader threads don't run further ahead of the consumer than this
+        static const int MAX_COMPLETED = 5;
+
+        DecodePoolRef                               mPool;
+        std::atomic<int>                            mDecoding;
+
+        //! guards the throttle and the number of pool threads at work for this store
+        LoadThrottle                                mThrottle;
+        int                                         mActive;
+        bool                                        mPaused;
+        std::mutex                                  mGateMutex;
+
+        KeyRegistry                                 mKeys;
+        std::vector<ci::fs::path>                   mSearchPaths;
+        std::function<ci::fs::path (const std::string &)> mPathResolver;
+        std::mutex                                  mPathMutex;
+
+        //! queue of images to load asynchronously, probes first, then requests and prefetches last
+        ConcurrentPriorityQueue<Job, Job::Hash>     mQueue;
+        //! requested images that haven't been taken yet
+        std::unordered_set<uint32_t>                mRequested;
+        std::mutex                                  mRequestedMutex;
+        std::vector<std::weak_ptr<LoadBatch>>       mBatches;
+        std::mutex                                  mBatchMutex;
+        ConcurrentMap<uint32_t, DecodedImage>       mCompleted;
+        ConcurrentQueue<ReloadedImage>              mReloaded;
+        DirectoryWatcherRef                         mWatcher;
+        //! counts the changes of every watched file, a decode that started on an older version is done again
+        std::unordered_map<uint32_t, uint32_t>      mFileVersions;
+        std::mutex                                  mVersionMutex;
+        //! decoded ahead of time and not asked for yet
+        LruCache<uint32_t, DecodedImage>            mPrefetched;
+        AccessManifest                              mAccessManifest;
+
+        //! probed headers, including the ones that failed
+        std::unordered_map<uint32_t, ImageInfo>     mProbed;
+        std::mutex                                  mProbeMutex;
+        std::condition_variable                     mProbeCondition;
+
+        //! surfaces loaded through load()/fetch(), with the bytes they were decoded from
+        std::unordered_map<uint32_t, ci::SurfaceRef> mSurfaceRefs;
+        std::unordered_map<uint32_t, ci::BufferRef>  mEncodedRefs;
+        LruCache<uint32_t, ci::BufferRef>           mEncodedTier;
+        //! see lendEncoded(), not counted against the budget as their owners count them already
+        ConcurrentMap<uint32_t, ci::BufferRef>      mLentEncoded;
+        //! the tier's own budget is what the held bytes leave of this one
+        size_t                                      mCpuTierBudget;
+        size_t                                      mHeldEncodedBytes;
+        mutable std::mutex                          mTierMutex;
+
+        LoadStats                                   mLoadStats;
+    };
+
+} // namespace rph
@@ -29,117 +29,174 @@
 
 namespace rph {
     
+    namespace {
+        
+        //! makes a store's context current while it creates or releases textures and hands the previous one back afterwards
+        class ScopedUploadContext {
+          public:
+            ScopedUploadContext( const ci::gl::ContextRef &context )
+            : mPrevious( ci::gl::context() ), mSwitched( context && context.get() != mPrevious )
+            {
+                if( mSwitched ) context->makeCurrent();
+            }
+            ~ScopedUploadContext(){
+                if( mSwitched && mPrevious ) mPrevious->makeCurrent();
+            }
+            
+          private:
+            ci::gl::Context *mPrevious;
+            bool            mSwitched;
+        };
+        
+    } // anonymous namespace
+    
     TextureStore* TextureStore::m_pInstance = NULL;
     TextureStore* TextureStore::getInstance(){
-        if (!m_pInstance){ // Only allow one instance of class to be generated.
-            m_pInstance = new TextureStore;
+        if (!m_pInstance){ // the default instance, create() makes more
+            m_pInstance = new TextureStore( ci::gl::ContextRef(), DecodePool::getDefault() );
             //m_pInstance->setup();
         }
         return m_pInstance;
     }
     
-    TextureStore::TextureStore(){
+    TextureStoreRef TextureStore::create(const ci::gl::ContextRef &context, const DecodePoolRef &pool){
+        return TextureStoreRef( new TextureStore( context, pool ) );
+    }
+    
+    TextureStore::TextureStore(const ci::gl::ContextRef &context, const DecodePoolRef &pool)
+    : mSurfaceStore( SurfaceStore::create( pool ) )
+    , mContext( context )
+    , validFileExtension( mSurfaceStore->validFileExtension )
+    , mKeys( mSurfaceStore->getKeys() )
+    , mUploadedBytes( 0 )
+    , mUploadBudget( mSurfaceStore->getThrottle().getUploadBytes() )
+    , mFrameStartTime( -1.0 )
+    , mPaused( false )
+    {
         // initialize buffers
         mTextureRefs.clear();
-        mSurfaces.clear();
-        mShouldQuit = false;
-        // create and launch the thread
-        mThread = std::shared_ptr<std::thread>( new std::thread( std::bind( &TextureStore::loadImagesThreadFn, this ) ) );
+        // let the SurfaceStore find ASSETS and RESOURCES
+        mSurfaceStore->setPathResolver( []( const std::string &url ){ return ci::app::getAssetPath( url ); } );
+        mSurfaceStore->addSearchPath( ci::app::Platform::get()->getResourcePath("") );
     }
 
     TextureStore::~TextureStore(){
-        // stop thread
-        mShouldQuit = true;
-        try{
-            mThread->join();
-        }catch(...){}
-        // clear buffers
-        mSurfaces.clear();
-        mTextureRefs.clear();
-        mLoadingQueue.clear();
-        mQueue.clear();
+        // clear buffers, the SurfaceStore stops its own threads. Textures are deleted in the context they were made in.
+        {
+            ScopedUploadContext context( mContext );
+            mTextureRefs.clear();
+            mTextureRefsNonGarbageCollectable.clear();
+        }
+        // the SurfaceStore may be shared and outlive this store
+        for( auto &held : mEncodedRefs ) mSurfaceStore->releaseEncoded( held.second.encoded );
+        mEncodedRefs.clear();
+        mLoading.clear();
     }
     
 
     
-    bool TextureStore::isLoading(const std::string &url){
-        return mLoadingQueue.contains(url);
+    FormatDescriptor TextureStore::describeFormat(const ci::gl::Texture::Format &fmt){
+        FormatDescriptor desc;
+        desc.target         = fmt.getTarget();
+        desc.wrapS          = fmt.getWrapS();
+        desc.wrapT          = fmt.getWrapT();
+        desc.wrapR          = fmt.getWrapR();
+        desc.minFilter      = fmt.getMinFilter();
+        desc.magFilter      = fmt.getMagFilter();
+        desc.internalFormat = fmt.getInternalFormat();
+        desc.dataType       = fmt.getDataType();
+        desc.maxAnisotropy  = fmt.getMaxAnisotropy();
+        desc.mipmapping     = fmt.hasMipmapping();
+        desc.baseMipLevel   = fmt.getBaseMipmapLevel();
+        desc.maxMipLevel    = fmt.getMaxMipmapLevel();
+        desc.loadTopDown    = fmt.getLoadTopDown();
+        std::copy( fmt.getSwizzleMask().begin(), fmt.getSwizzleMask().end(), desc.swizzle.begin() );
+        desc.compareMode    = fmt.getCompareMode();
+        desc.compareFunc    = fmt.getCompareFunc();
+#if ! defined( CINDER_GL_ES )
+        std::copy( fmt.getBorderColor().begin(), fmt.getBorderColor().end(), desc.borderColor.begin() );
+#endif
+        return desc;
+    }
+    
+    TextureKey TextureStore::getKey(const std::string &url, const ci::gl::Texture::Format &fmt){
+        TextureKey key = mKeys.intern( url, describeFormat( fmt ) );
+        // remember the full format, the descriptor only holds the fields that tell entries apart
+        if( mFormats.find( key ) == mFormats.end() )
+            mFormats[ key ] = fmt;
+        return key;
+    }
+    
+    bool TextureStore::isLoading(const std::string &url, const ci::gl::Texture::Format &fmt){
+        TextureKey key = mKeys.find( url, describeFormat( fmt ) );
+        return key.isValid() && isLoading( key );
+    }
+    
+    bool TextureStore::isLoading(TextureKey key){
+        return mLoading.find( key ) != mLoading.end();
     }
     
-    bool TextureStore::isLoaded(const std::string &url){
-        return (mTextureRefs.find( url ) != mTextureRefs.end());
+    bool TextureStore::isLoaded(const std::string &url, const ci::gl::Texture::Format &fmt){
+        TextureKey key = mKeys.find( url, describeFormat( fmt ) );
+        return key.isValid() && isLoaded( key );
+    }
+    
+    bool TextureStore::isLoaded(TextureKey key){
+        return (mTextureRefs.find( key ) != mTextureRefs.end());
+    }
+    
+    ci::gl::Texture::Format TextureStore::getFormat(TextureKey key) const {
+        auto itr = mFormats.find( key );
+        return ( itr != mFormats.end() ) ? itr->second : ci::gl::Texture::Format();
+    }
+    
+    ci::gl::TextureRef TextureStore::storeTexture(TextureKey key, const ci::gl::TextureRef &texRef, const ci::BufferRef &encoded, bool isGarbageCollectable){
+        mTextureRefs[ key ] = texRef;
+        holdEncoded( key, encoded );
+        if(!isGarbageCollectable){
+            mTextureRefsNonGarbageCollectable[ key ] = texRef;
+        }
+        return texRef;
     }
     
     ci::gl::TextureRef TextureStore::load(const std::string &url, ci::gl::Texture::Format fmt, bool isGarbageCollectable, bool runGarbageCollector)
     {
+        return load( getKey( url, fmt ), isGarbageCollectable, runGarbageCollector );
+    }
+    
+    ci::gl::TextureRef TextureStore::load(TextureKey key, bool isGarbageCollectable, bool runGarbageCollector)
+    {
+        recordAccess( key );
+        
         // if texture already exists, return it immediately
-        if (mTextureRefs.find( url ) != mTextureRefs.end())
-            return mTextureRefs[ url ];
+        auto existing = mTextureRefs.find( key );
+        if (existing != mTextureRefs.end()){
+            mGpuTierStats.hits++;
+            return existing->second;
+        }
         
         // otherwise, check if the image has loaded and create a texture for it
-        ci::Surface surface;
-        if( mSurfaces.try_pop(url, surface) ) {
+        const uint32_t urlId = mKeys.getUrlId( key );
+        DecodedImage decoded;
+        if( mSurfaceStore->tryTake( urlId, decoded ) ) {
             // done loading
-            mLoadingQueue.erase(url);
+            mLoading.erase(key);
             
             // perform garbage collection to make room for new textures
             if(runGarbageCollector)garbageCollect();
             
 //            ci::app::console() << ci::app::getElapsedSeconds() << ": creating Texture for '" << url << "'." << std::endl;
 
-            ci::gl::TextureRef texRef = ci::gl::Texture::create(surface, fmt);
-            mTextureRefs[ url ] = texRef;
-            return texRef;
+            return storeTexture( key, uploadTexture( key, *decoded.surface ), decoded.encoded, isGarbageCollectable );
         }
         
         // load texture and add to TextureList
+        mGpuTierStats.misses++;
         //ci::app::console() << "Loading Texture '" << url << "'." << std::endl;
-        try
+        lendEncoded( key );
+        if( mSurfaceStore->decode( urlId, decoded ) ) try
         {
-            ci::ImageSourceRef img = ci::loadImage( url );
-            ci::gl::TextureRef t = ci::gl::Texture::create( img, fmt );
-            mTextureRefs[ url ] = t;
-            if(!isGarbageCollectable){
-                mTextureRefsNonGarbageCollectable[ url ] = t;
-            }
-            return t;
-        }
-        catch(...){}
-
-        try
-        {
-            ci::ImageSourceRef img = ci::loadImage( ci::app::loadAsset( url ) );
-            ci::gl::TextureRef t = ci::gl::Texture::create( img, fmt );
-            mTextureRefs[ url ] = t;
-            if(!isGarbageCollectable){
-                mTextureRefsNonGarbageCollectable[ url ] = t;
-            }
-            return t;
-        }
-        catch(...){}
-        
-        // currently not windows compatible:
-//        try
-//        {
-//            ci::ImageSourceRef img = ci::loadImage( ci::app::loadResource( url ) );
-//            ci::gl::TextureRef t = ci::gl::Texture::create( img, fmt );
-//            mTextureRefs[ url ] = t;
-//            if(!isGarbageCollectable){
-//                mTextureRefsNonGarbageCollectable[ url ] = t;
-//            }
-//            return t;
-//        }
-//        catch(...){}
-        
-        try
-        {
-            ci::ImageSourceRef img = ci::loadImage( loadUrl( ci::Url(url) ) );
-            ci::gl::TextureRef t = ci::gl::Texture::create( img, fmt );
-            mTextureRefs[ url ] = t;
-            if(!isGarbageCollectable){
-                mTextureRefsNonGarbageCollectable[ url ] = t;
-            }
-            return t;
+            return storeTexture( key, uploadTexture( key, *decoded.surface ), decoded.encoded, isGarbageCollectable );
         }
         catch(...){}
         
@@ -147,7 +204,7 @@ namespace rph {
         garbageCollect();
         
         // did not succeed
-        ci::app::console() << ci::app::getElapsedSeconds() << ": error loading texture '" << url << "'!" << std::endl;
+        ci::app::console() << ci::app::getElapsedSeconds() << ": error loading texture '" << mKeys.getUrl( key ) << "'!" << std::endl;
 
         return NULL; //ci::gl::Texture::create( ci::gl::Texture() ); // return NULL?
     }
@@ -156,33 +213,39 @@ namespace rph {
         
         //ci::app::console() << "rph::TextureStore::loadImageDirectory" << std::endl;
         
-        std::vector<ci::gl::TextureRef> textureRefs;
-        textureRefs.clear();
-        
-        std::vector<std::string> pathsToLoad;
-        pathsToLoad.clear();
+        // sorted alphabetically, looked up in the resources if it doesn't exist as given
+        std::vector<std::string> pathsToLoad = mSurfaceStore->listImageDirectory( dir );
+        std::vector<ci::gl::TextureRef> textureRefs( pathsToLoad.size() );
         
-        if( !ci::fs::exists( dir ) ){
-            //ci::app::console() << "rph::TextureStore::loadImageDirectory - WARNING - ("<< dir << ") Folder does not Exist!" << std::endl;
-            dir = ci::app::Platform::get()->getResourcePath("") / dir;
-            if( !ci::fs::exists(dir) ){
-                ci::app::console() << "rph::TextureStore::loadImageDirectory - ERROR - ("<< dir << ") Folder does not Exist!" << std::endl;
-                return textureRefs;
+        // the stored ones are done, the others get decoded as a batch
+        std::vector<TextureKey> keys;
+        std::vector<uint32_t> urlIds;
+        std::vector<size_t> indices;
+        for( size_t i = 0; i < pathsToLoad.size(); ++i ){
+            TextureKey key = getKey( pathsToLoad[i], fmt );
+            recordAccess( key );
+            auto existing = mTextureRefs.find( key );
+            if( existing != mTextureRefs.end() ){
+                mGpuTierStats.hits++;
+                textureRefs[i] = existing->second;
+                if( !isGarbageCollectable ) mTextureRefsNonGarbageCollectable[ key ] = existing->second;
+                continue;
             }
+            mGpuTierStats.misses++;
+            keys.push_back( key );
+            urlIds.push_back( mKeys.getUrlId( key ) );
+            indices.push_back( i );
         }
-        for ( ci::fs::directory_iterator it( dir ); it != ci::fs::directory_iterator(); ++it ){
-            if ( ci::fs::is_regular_file( *it ) && hasValidFileExtension( it->path().extension() ) ){
-                pathsToLoad.push_back( it->path().string() );
+        
+        // upload on this thread while the pool decodes the rest
+        mSurfaceStore->decodeBatch( urlIds, [&]( size_t index, const DecodedImage &decoded ){
+            mLoading.erase( keys[index] );
+            try {
+                textureRefs[ indices[index] ] = storeTexture( keys[index], uploadTexture( keys[index], *decoded.surface ), decoded.encoded, isGarbageCollectable );
+            } catch(...) {
+                ci::app::console() << ci::app::getElapsedSeconds() << ": error loading texture '" << mKeys.getUrl( keys[index] ) << "'!" << std::endl;
             }
-//            else{
-//                ci::app::console() << "NOT loading: " <<  it->path().c_str() << std::endl;
-//            }
-        }
-        sort( pathsToLoad.begin(), pathsToLoad.end() ); // sort alphabetically
-        for( auto it = pathsToLoad.begin(); it != pathsToLoad.end(); it++ ){
-            //ci::app::console() << "rph::TextureStore::loadImageDirectory - loading:("<< (*it) << ")" << std::endl;
-            textureRefs.push_back( load( (*it) , fmt, isGarbageCollectable, false ) );
-        }
+        } );
         
         garbageCollect();
         return textureRefs;
@@ -191,36 +254,45 @@ namespace rph {
     
     ci::gl::TextureRef TextureStore::fetch(const std::string &url, ci::gl::Texture::Format fmt, bool isGarbageCollectable, bool runGarbageCollector)
     {
+        return fetch( getKey( url, fmt ), isGarbageCollectable, runGarbageCollector );
+    }
+    
+    ci::gl::TextureRef TextureStore::fetch(TextureKey key, bool isGarbageCollectable, bool runGarbageCollector)
+    {
+        recordAccess( key );
+        
         // if texture already exists, return it immediately
-        if (mTextureRefs.find( url ) != mTextureRefs.end())
-            return mTextureRefs[ url ];
+        auto existing = mTextureRefs.find( key );
+        if (existing != mTextureRefs.end()){
+            mGpuTierStats.hits++;
+            return existing->second;
+        }
 
-        // otherwise, check if the image has loaded and create a texture for it
-        ci::Surface surface;
-        if( mSurfaces.try_pop(url, surface) ) {
+        // otherwise, check if the image has loaded and create a texture for it,
+        // unless this frame's uploads are used up. The first upload of a frame always goes through.
+        const uint32_t urlId = mKeys.getUrlId( key );
+        DecodedImage decoded;
+        const bool canUpload = !mPaused && ( mUploadedBytes == 0 || mUploadedBytes < mUploadBudget );
+        if( canUpload && mSurfaceStore->tryTake( urlId, decoded ) ) {
+            mUploadedBytes += size_t( decoded.surface->getRowBytes() ) * decoded.surface->getHeight();
             // done loading
-            mLoadingQueue.erase(url);
+            mLoading.erase(key);
 
             // perform garbage collection to make room for new textures
             if(runGarbageCollector)garbageCollect();
 
             //ci::app::console() << ci::app::getElapsedSeconds() << ": creating Texture for '" << url << "'." << std::endl;
             
-            ci::gl::TextureRef texRef = ci::gl::Texture::create(surface, fmt);
-            mTextureRefs[ url ] = texRef;
-            if(!isGarbageCollectable){
-                mTextureRefsNonGarbageCollectable[ url ] = texRef;
-            }
-            return texRef;
+            return storeTexture( key, uploadTexture( key, *decoded.surface ), decoded.encoded, isGarbageCollectable );
         }
         
         // add to list of currently loading/scheduled files
-        if( mLoadingQueue.push_back(url, true) ) {
-            // hand over to threaded loader
-            if( mQueue.push_back(url, true) ) {
-                //ci::app::console() << ci::app::getElapsedSeconds() << ": queueing Texture '" << url << "' for loading." << std::endl;
-            }
+        if( mLoading.insert(key).second ) {
+            mGpuTierStats.misses++;
         }
+        // hand over to threaded loader, again if another format of the same url took the last decode
+        lendEncoded( key );
+        mSurfaceStore->request( urlId );
         return NULL;
     }
     
@@ -230,30 +302,29 @@ namespace rph {
         std::vector<ci::gl::TextureRef> textureRefs;
         textureRefs.clear();
         
-        std::vector<std::string> pathsToLoad;
-        pathsToLoad.clear();
-        
-        if( !ci::fs::exists( dir ) ){
-            //ci::app::console() << "rph::TextureStore::loadImageDirectory - WARNING - ("<< dir << ") Folder does not Exist!" << std::endl;
-            dir = ci::app::Platform::get()->getResourcePath("") / dir;
-            if( !ci::fs::exists(dir) ){
-                ci::app::console() << "rph::TextureStore::loadImageDirectory - ERROR - ("<< dir << ") Folder does not Exist!" << std::endl;
-                return textureRefs;
-            }
+        std::vector<std::string> pathsToLoad = mSurfaceStore->listImageDirectory( dir );
+        std::vector<TextureKey> keys;
+        keys.reserve( pathsToLoad.size() );
+        for( auto it = pathsToLoad.begin(); it != pathsToLoad.end(); it++ ){
+            keys.push_back( getKey( *it, fmt ) );
         }
-        for ( ci::fs::directory_iterator it( dir ); it != ci::fs::directory_iterator(); ++it ){
-            if ( ci::fs::is_regular_file( *it ) && hasValidFileExtension( it->path().extension() ) ){
-                pathsToLoad.push_back( it->path().string() );
-            }
+        
+        // queue everything that is missing in one go, so the whole folder decodes in parallel
+        std::vector<uint32_t> urlIds;
+        for( TextureKey key : keys ){
+            if( mTextureRefs.find( key ) == mTextureRefs.end() && !mSurfaceStore->isRequested( mKeys.getUrlId( key ) ) )
+                urlIds.push_back( mKeys.getUrlId( key ) );
         }
-        sort( pathsToLoad.begin(), pathsToLoad.end() ); // sort alphabetically
-        for( auto it = pathsToLoad.begin(); it != pathsToLoad.end(); it++ ){
-            //ci::app::console() << "rph::TextureStore::loadImageDirectory - loading:("<< (*it) << ")" << std::endl;
-//            textureRefs.push_back( load( (*it), fmt, isGarbageCollectable, false ) );
-            ci::gl::TextureRef t = fetch( (*it), fmt, false, false );
+        if( !urlIds.empty() ) mSurfaceStore->request( urlIds );
+        
+        // take whatever is ready, the rest comes in on the next calls
+        for( TextureKey key : keys ){
+            //ci::app::console() << "rph::TextureStore::loadImageDirectory - loading:("<< mKeys.getUrl( key ) << ")" << std::endl;
+//            textureRefs.push_back( load( key, isGarbageCollectable, false ) );
+            ci::gl::TextureRef t = fetch( key, false, false );
             if( !t ){
                 notYetLoadedCount++;
-                break;
+                continue;
             }
             textureRefs.push_back( t );
         }
@@ -283,74 +354,181 @@ namespace rph {
     }
     
     
-    void TextureStore::loadImagesThreadFn()
+    std::vector<TiledTexture> TextureStore::fetchTiles(const TilePyramidRef &pyramid, const ci::Area &region, float scale, ci::gl::Texture::Format fmt)
     {
-        ci::ThreadSetup threadSetup; // instantiate this if you're talking to Cinder from a secondary thread
+        std::vector<TiledTexture> tiles;
+        if( !pyramid ) return tiles;
         
-        bool                succeeded;
-        ci::Surface			surface;
-        ci::ImageSourceRef	image;
-        std::string			url;
+        const TileGrid &grid = pyramid->getGrid();
+        const std::vector<TileId> visible = grid.getTilesForScale( PixelRect( region.getX1(), region.getY1(), region.getX2(), region.getY2() ), scale );
         
-        ci::app::console() << "TEXTURESTORE THREAD STARTED" << std::endl;
-        // run until interrupted
-        while( ( ! mShouldQuit ) ) {
-            if( mSurfaces.size() > 5 ) continue;
-            mQueue.wait_and_pop_front(url);
-            
-            // try to load image
-            succeeded = false;
-            
-            // try to load from FILE (fastest)
-            if(!succeeded) try {
-                image = ci::loadImage( ci::loadFile( url ) );
-                succeeded = true;
-            } catch(...) {}
-            
-            // try to load from ASSET (fast)
-            if(!succeeded) try {
-                image = ci::loadImage( ci::app::loadAsset( url ) );
-                succeeded = true;
-            } catch(...) {}
-            
-            // try to load from RESOURCES (fast) // currently not windows compatible:
-//            if(!succeeded) try {
-//                image = ci::loadImage( ci::app::loadResource( url ) );
-//                succeeded = true;
-//            } catch(...) {}
-            
-            // try to load from URL (slow)
-            if(!succeeded) try {
-                image = ci::loadImage( ci::loadUrl( ci::Url(url) ) );
-                succeeded = true;
-            } catch(...) {}
-            
-            // do NOT continue if not succeeded (yeah, it's confusing, I know)
-            if(!succeeded) continue;
-            
-            // create Surface from the image
-            try {
-                surface = ci::Surface(image);
-                
-// resize image if larger than 4096 px
-//            Area source = surface.getBounds();
-//            Area dest(0, 0, 4096, 4096);
-//            Area fit = Area::proportionalFit(source, dest, false, false);
-//            if(source.getSize() != fit.getSize())
-//                surface = ci::ip::resizeCopy(surface, source, fit.getSize());
-
-                // copy to main thread
-                mSurfaces.push(url, surface);
-            }catch(...){}
+        // ask for the tiles in view
+        std::unordered_set<TextureKey> keys;
+        for( const TileId &tile : visible ){
+            TextureKey key = getKey( pyramid->getTileUrl( tile ), fmt );
+            keys.insert( key );
+            fetch( key, true, false );
+        }
+        // and take back the ones that went out of view before they were uploaded, or they would
+        // pile up in the queue and hold the decoded images no one is going to take. The same goes
+        // for all tiles of pyramids that have been let go of.
+        for( auto itr = mTileRequests.begin(); itr != mTileRequests.end(); ){
+            if( !itr->first.expired() ){
+                ++itr;
+                continue;
+            }
+            for( TextureKey key : itr->second ){
+                if( isLoading( key ) ) cancelLoading( key );
+            }
+            itr = mTileRequests.erase( itr );
+        }
+        std::vector<TextureKey> &requested = mTileRequests[ pyramid ];
+        for( TextureKey key : requested ){
+            if( keys.find( key ) == keys.end() && isLoading( key ) ) cancelLoading( key );
+        }
+        requested.assign( keys.begin(), keys.end() );
+        
+        // draw what is loaded, with lower resolution tiles standing in for the rest. Only looks
+        // the stand-ins up, so tiles that were never loaded don't get interned.
+        const FormatDescriptor desc = describeFormat( fmt );
+        auto findTexture = [&]( const TileId &tile ){
+            auto itr = mTextureRefs.find( mKeys.find( pyramid->getTileUrl( tile ), desc ) );
+            return ( itr != mTextureRefs.end() ) ? itr->second : ci::gl::TextureRef();
+        };
+        for( const TileId &tile : grid.getDrawTiles( visible, [&]( const TileId &tile ){ return bool( findTexture( tile ) ); } ) ){
+            const PixelRect bounds = grid.getTileRegion( tile );
+            tiles.push_back( TiledTexture{ findTexture( tile ), ci::Rectf( float( bounds.x1 ), float( bounds.y1 ), float( bounds.x2 ), float( bounds.y2 ) ) } );
+        }
+        
+        // everything in view is held by the result now, the rest can go
+        garbageCollect();
+        return tiles;
+    }
+    
+    void TextureStore::cancelLoading(TextureKey key)
+    {
+        mLoading.erase( key );
+        // the decode is shared with the other formats of the url
+        const uint32_t urlId = mKeys.getUrlId( key );
+        for( TextureKey loading : mLoading ){
+            if( mKeys.getUrlId( loading ) == urlId ) return;
+        }
+        mSurfaceStore->cancel( urlId );
+    }
+    
+    LoadBatchRef TextureStore::prefetch(const std::vector<std::string> &urls, int priority, const ci::gl::Texture::Format &fmt)
+    {
+        // the surface store only knows its own surfaces, so leave out what already is a Texture
+        const FormatDescriptor desc = describeFormat( fmt );
+        std::vector<std::string> missing;
+        missing.reserve( urls.size() );
+        for( const std::string &url : urls ){
+            if( !isLoaded( mKeys.find( url, desc ) ) ) missing.push_back( url );
+        }
+        return mSurfaceStore->prefetch( missing, priority );
+    }
+    
+    void TextureStore::recordAccess(TextureKey key)
+    {
+        // only look the url up while recording, this runs for every stored texture on every frame
+        AccessManifest &manifest = mSurfaceStore->getAccessManifest();
+        if( manifest.isRecording() ) manifest.record( mKeys.getUrlId( key ) );
+    }
+    
+    ci::gl::TextureRef TextureStore::uploadTexture(TextureKey key, const ci::Surface &surface)
+    {
+        RPH_STATS( const std::string url = mKeys.getUrl( key ) );
+        RPH_STATS_SCOPE( getLoadStats(), LoadStage::UPLOAD, url );
+        ScopedUploadContext context( mContext );
+        return ci::gl::Texture::create( surface, getFormat( key ) );
+    }
+    
+    void TextureStore::replaceTexture(TextureKey key, const DecodedImage &decoded)
+    {
+        ci::gl::TextureRef &texture = mTextureRefs[ key ];
+        const ci::Surface &surface = *decoded.surface;
+        // the old texture may be released below
+        ScopedUploadContext context( mContext );
+        if( texture->getWidth() == surface.getWidth() && texture->getHeight() == surface.getHeight() && !getFormat( key ).hasMipmapping() ) {
+            // same size, update the pixels so every ref handed out shows the new version
+            RPH_STATS( const std::string url = mKeys.getUrl( key ) );
+            RPH_STATS_SCOPE( getLoadStats(), LoadStage::UPLOAD, url );
+            texture->update( surface );
+        } else {
+            // refs handed out keep the old version until they are fetched again
+            texture = uploadTexture( key, surface );
+            auto nonCollectable = mTextureRefsNonGarbageCollectable.find( key );
+            if( nonCollectable != mTextureRefsNonGarbageCollectable.end() ) nonCollectable->second = texture;
+        }
+        holdEncoded( key, decoded.encoded );
+    }
+    
+    void TextureStore::holdEncoded(TextureKey key, const ci::BufferRef &encoded)
+    {
+        releaseEncoded( key );
+        // another format of the url holds its bytes already, they only count once
+        const uint32_t urlId = mKeys.getUrlId( key );
+        auto itr = mEncodedRefs.find( urlId );
+        if( itr != mEncodedRefs.end() ){
+            itr->second.keys.insert( key );
+            return;
+        }
+        // hold on to the encoded bytes so the texture can be demoted to the cpu tier when it gets evicted,
+        // as long as they fit its budget
+        if( mSurfaceStore->holdEncoded( encoded ) ) mEncodedRefs[ urlId ] = HeldEncoded{ encoded, { key } };
+    }
+    
+    void TextureStore::releaseEncoded(TextureKey key)
+    {
+        auto itr = mEncodedRefs.find( mKeys.getUrlId( key ) );
+        if( itr == mEncodedRefs.end() || itr->second.keys.erase( key ) == 0 || !itr->second.keys.empty() ) return;
+        mSurfaceStore->releaseEncoded( itr->second.encoded );
+        mEncodedRefs.erase( itr );
+    }
+    
+    void TextureStore::lendEncoded(TextureKey key)
+    {
+        auto itr = mEncodedRefs.find( mKeys.getUrlId( key ) );
+        if( itr != mEncodedRefs.end() ) mSurfaceStore->lendEncoded( itr->first, itr->second.encoded );
+    }
+    
+    void TextureStore::updateWatched()
+    {
+        for( const DirectoryWatcher::Change &change : mSurfaceStore->updateWatched() ){
+            const uint32_t urlId = mKeys.findUrl( change.path );
+            if( urlId != TextureKey::INVALID_ID ){
+                // the bytes held to demote the stored textures later are of the old version
+                auto held = mEncodedRefs.find( urlId );
+                if( held != mEncodedRefs.end() ){
+                    mSurfaceStore->releaseEncoded( held->second.encoded );
+                    mEncodedRefs.erase( held );
+                }
+                // the SurfaceStore redoes the decodes of textures that are still loading, stored ones get reloaded
+                if( change.type == DirectoryWatcher::Change::MODIFIED ){
+                    for( auto &entry : mTextureRefs ){
+                        if( mKeys.getUrlId( entry.first ) == urlId ){
+                            mSurfaceStore->reload( urlId );
+                            break;
+                        }
+                    }
+                }
+            }
+            if( mFileChangedHandler ) mFileChangedHandler( change );
+        }
+        
+        // swap in the new versions under the same keys, in every format they are stored in
+        for( const SurfaceStore::ReloadedImage &image : mSurfaceStore->takeReloaded() ){
+            for( auto &entry : mTextureRefs ){
+                if( mKeys.getUrlId( entry.first ) == image.urlId ) replaceTexture( entry.first, image.decoded );
+            }
         }
-        ci::app::console() << "TEXTURESTORE THREAD STOPPED" << std::endl;
     }
     
 	void TextureStore::releaseTexture(ci::gl::TextureRef texture) {
-		for (std::map<std::string, ci::gl::TextureRef>::iterator itr = mTextureRefsNonGarbageCollectable.begin(); itr != mTextureRefsNonGarbageCollectable.end();) {
+		for (auto itr = mTextureRefsNonGarbageCollectable.begin(); itr != mTextureRefsNonGarbageCollectable.end();) {
 			//remove it
 			if (itr->second == texture) {
-				//ci::app::console() << "Releasing: "<< itr->first << std::endl;
+				//ci::app::console() << "Releasing: "<< mKeys.getUrl(itr->first) << std::endl;
 				mTextureRefsNonGarbageCollectable.erase(itr++);
 				//exit, there should only be 1 ref in the map
 				return;
@@ -366,24 +544,52 @@ namespace rph {
 		}
 	}
     void TextureStore::garbageCollect(){
+        RPH_STATS_SCOPE( getLoadStats(), LoadStage::GARBAGE_COLLECT );
 //        int s = mTextureRefs.size();
-        for(std::map<std::string, ci::gl::TextureRef>::iterator itr=mTextureRefs.begin();itr!=mTextureRefs.end();){
+        std::vector<ci::gl::TextureRef> evicted;
+        for(auto itr=mTextureRefs.begin();itr!=mTextureRefs.end();){
             if(itr->second.use_count() < 2){
-                //ci::app::console() << ci::app::getElapsedSeconds() << ": removing texture '" << itr->first << "' because it is no longer in use." << std::endl;
+                //ci::app::console() << ci::app::getElapsedSeconds() << ": removing texture '" << mKeys.getUrl(itr->first) << "' because it is no longer in use." << std::endl;
+                demote(itr->first);
+                mGpuTierStats.evictions++;
+                evicted.push_back(std::move(itr->second));
                 mTextureRefs.erase(itr++);
             } else {
                 ++itr;
             }
         }
+        // delete them in the context they were made in, only switching if there are any
+        if( !evicted.empty() ){
+            ScopedUploadContext context( mContext );
+            evicted.clear();
+        }
 //        ci::app::console() << ci::app::getElapsedSeconds() << "TextureStore::garbageCollect() removed: " << (s-mTextureRefs.size()) << std::endl;
     }
     
+    void TextureStore::demote(TextureKey key){
+        auto itr = mEncodedRefs.find( mKeys.getUrlId( key ) );
+        if( itr == mEncodedRefs.end() || itr->second.keys.erase( key ) == 0 ) return;
+        
+        // the other formats of the url that are still stored keep holding them
+        if( !itr->second.keys.empty() ) return;
+        mSurfaceStore->demote( itr->first, itr->second.encoded );
+        mEncodedRefs.erase( itr );
+    }
+    
+    void TextureStore::setCpuTierBudget(size_t bytes){
+        if( bytes == 0 ){
+            for( auto &held : mEncodedRefs ) mSurfaceStore->releaseEncoded( held.second.encoded );
+            mEncodedRefs.clear();
+        }
+        mSurfaceStore->setCpuTierBudget( bytes );
+    }
+    
     void TextureStore::drawAllStoredTextures(float width, float height){
         
         int numOfColumns = ci::math<float>::floor( ci::app::getWindowWidth() / width );
         int count = 0;
         int rows = 0;
-        for( std::map<std::string, ci::gl::TextureRef>::iterator iter = mTextureRefs.begin(); iter != mTextureRefs.end(); iter++){
+        for( auto iter = mTextureRefs.begin(); iter != mTextureRefs.end(); iter++){
             ci::gl::pushMatrices();
             ci::gl::translate( (count++ % numOfColumns) * width, height * rows );
             if( count % numOfColumns == 0) rows++;
@@ -394,20 +600,60 @@ namespace rph {
         }
     }
     
-    bool TextureStore::hasValidFileExtension(ci::fs::path extension){
-        // std::vector<std::string> validFileExtension = {".png", ".jpg", ".jpeg"};
-        for(auto itr = validFileExtension.begin(); itr != validFileExtension.end(); itr++){
-            if( extension == (*itr) ){
-                //ci::app::console() << "Valid file extension: "<< (*itr) << std::endl;
-                return true;
-            }
+    LoadStats::Summary TextureStore::getStats(){
+        // queue depth, stages and cpu tier come from the SurfaceStore, its own surface cache is empty when used through here
+        LoadStats::Summary summary = mSurfaceStore->getStats();
+        summary.gpuTier = getGpuTierStats();
+        // estimate, drivers pad and mipmaps add a third on top
+        for( auto itr = mTextureRefs.begin(); itr != mTextureRefs.end(); ++itr ){
+            summary.bytesResident += uint64_t( itr->second->getWidth() ) * itr->second->getHeight() * 4;
         }
-        return false;
+        return summary;
+    }
+    
+    void TextureStore::update(){
+        mFrameStartTime = ci::app::getElapsedSeconds();
+        
+        if( !mPaused ) updateWatched();
+        
+        // start the next frame's uploads with the current budget
+        mUploadBudget = mSurfaceStore->getThrottle().getUploadBytes();
+        mUploadedBytes = 0;
+    }
+    
+    void TextureStore::endFrame(){
+        if( mFrameStartTime < 0.0 ) return;
+        addFrameWorkTime( ci::app::getElapsedSeconds() - mFrameStartTime );
+        mFrameStartTime = -1.0;
+    }
+    
+    void TextureStore::pause(){
+        mPaused = true;
+        mSurfaceStore->pause();
+    }
+    
+    void TextureStore::resume(){
+        mPaused = false;
+        mSurfaceStore->resume();
+        // the frame spent resuming says nothing about loading
+        mFrameStartTime = -1.0;
     }
     
     void TextureStore::status(){
+        LoadStats::Summary stats = getStats();
         ci::app::console() << "-------------------------" << std::endl;
         ci::app::console() << "mTextureRefs[ "<< mTextureRefs.size() << " ]" << std::endl;
         ci::app::console() << "mTextureRefsNonGarbageCollectable[ "<< mTextureRefsNonGarbageCollectable.size() << " ]" << std::endl;
+        ci::app::console() << "queue depth: " << stats.queueDepth << ", in flight: " << stats.inFlight << std::endl;
+        ci::app::console() << "decoded: " << stats.bytesDecoded / 1024 << " kB, resident: " << stats.bytesResident / 1024 << " kB" << std::endl;
+        ci::app::console() << "gpu tier: hit ratio " << stats.gpuTier.getHitRatio() << " (" << stats.gpuTier.hits << "/" << stats.gpuTier.hits + stats.gpuTier.misses << "), evictions " << stats.gpuTier.evictions << std::endl;
+        ci::app::console() << "cpu tier: hit ratio " << stats.cpuTier.getHitRatio() << " (" << stats.cpuTier.hits << "/" << stats.cpuTier.hits + stats.cpuTier.misses << "), " << mSurfaceStore->getCpuTierCount() << " images, " << stats.cpuTierBytes / 1024 << " of " << getCpuTierBudget() / 1024 << " kB" << std::endl;
+        for( int i = 0; i < int( LoadStage::COUNT ); ++i ){
+            const LoadStats::StageSummary &stage = stats.stages[i];
+            if( stage.count == 0 ) continue;
+            ci::app::console() << getStageName( LoadStage( i ) ) << ": " << stage.count << "x, mean " << stage.meanMicros / 1000.0 << " ms, p95 " << stage.p95Micros / 1000.0 << " ms, max " << stage.maxMicros / 1000.0 << " ms" << std::endl;
+        }
+        LoadThrottle throttle = mSurfaceStore->getThrottle();
+        ci::app::console() << "throttle: " << throttle.getDecoders() << " of " << throttle.getMaxDecoders() << " decoders, " << throttle.getUploadBytes() / 1024 << " kB uploads per frame, frame time " << throttle.getSmoothedFrameTime() * 1000.0 << " ms" << ( mPaused ? ", paused" : "" ) << std::endl;
     }
 } // namespace rph
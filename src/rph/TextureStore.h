@@ -30,35 +30,69 @@
 #include "cinder/app/App.h"
 #include "cinder/gl/gl.h"
 #include "cinder/gl/Texture.h"
-#include "cinder/Thread.h"
 #include "cinder/Utilities.h"
-#include "cinder/ConcurrentCircularBuffer.h"
 
-#include "rph/ConcurrentDeque.h"
-#include "rph/ConcurrentMap.h"
+#include "rph/KeyRegistry.h"
+#include "rph/LoadStats.h"
+#include "rph/LruCache.h"
+#include "rph/SurfaceStore.h"
+#include "rph/TilePyramid.h"
+
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace rph {
 
+    //! a tile of a TilePyramid that is ready to draw
+    struct TiledTexture {
+        ci::gl::TextureRef  texture;
+        //! the full resolution pixels the tile covers
+        ci::Rectf           bounds;
+    };
+    
+    typedef std::shared_ptr<class TextureStore> TextureStoreRef;
+    
     class TextureStore {
       private:
-        // singleton implementation
-        TextureStore();
-        ~TextureStore();
-        TextureStore(TextureStore const&){};
-        TextureStore& operator=(TextureStore const&){return *m_pInstance;};
+        // default instance for the helper functions
+        TextureStore(const ci::gl::ContextRef &context, const DecodePoolRef &pool);
+        TextureStore(TextureStore const&);
+        TextureStore& operator=(TextureStore const&);
         static TextureStore* m_pInstance;
         
+        //! does the resolving, reading and decoding, the TextureStore only uploads and caches the textures
+        SurfaceStoreRef mSurfaceStore;
+        //! uploads go into this context if set, otherwise into the current one
+        ci::gl::ContextRef mContext;
+        
       public:
+        //! the default store, used by the helper functions below
         static TextureStore* getInstance();
+        //! a store with its own textures, budgets and throttle, e.g. one per window or GL context. All stores on
+        //! a pool share its decode threads, which take turns between them. Textures are uploaded into the given
+        //! context, or into whichever one is current when fetch() or load() runs.
+        static TextureStoreRef create(const ci::gl::ContextRef &context = ci::gl::ContextRef(), const DecodePoolRef &pool = DecodePool::getDefault());
+        ~TextureStore();
         
         
+        //! synchronously loads all images of a directory. They decode on the pool and this thread at once, and upload here as they come in.
         std::vector<ci::gl::TextureRef> loadImageDirectory(ci::fs::path path, ci::gl::Texture::Format fmt=ci::gl::Texture::Format(), bool isGarbageCollectable = true );
+        //! asynchronously loads all images of a directory as one batch, returns nothing until all of them are ready
         std::vector<ci::gl::TextureRef> fetchImageDirectory(ci::fs::path path, ci::gl::Texture::Format fmt=ci::gl::Texture::Format(), bool isGarbageCollectable = true );
         
+        //! returns the handle for a (url, format) pair. Keep it around to skip string lookups on every frame
+        TextureKey getKey(const std::string &url, const ci::gl::Texture::Format &fmt=ci::gl::Texture::Format());
+        //! returns the url a handle was created for
+        std::string getUrl(TextureKey key) const { return mSurfaceStore->getKeys().getUrl(key); }
+        
         //! synchronously loads an image into a texture, stores it and returns it
         ci::gl::TextureRef	load(const std::string &url, ci::gl::Texture::Format fmt=ci::gl::Texture::Format(), bool isGarbageCollectable = true, bool runGarbageCollector = true);
+        ci::gl::TextureRef	load(TextureKey key, bool isGarbageCollectable = true, bool runGarbageCollector = true);
         //! asynchronously loads an image into a texture, returns immediately
         ci::gl::TextureRef	fetch(const std::string &url, ci::gl::Texture::Format fmt=ci::gl::Texture::Format(), bool isGarbageCollectable = true, bool runGarbageCollector = true);
+        ci::gl::TextureRef	fetch(TextureKey key, bool isGarbageCollectable = true, bool runGarbageCollector = true);
         
 		void releaseTexture(ci::gl::TextureRef texture); //allow garbage collection
 		//void releaseTexture(const std::string &url); //allow garbage collection (implement path based version)
@@ -66,13 +100,84 @@ namespace rph {
 		void releaseTextures(std::vector<ci::gl::TextureRef> textures); //allow garbage collection
 
         //! returns TRUE if image is scheduled for loading but has not been turned into a Texture yet
-        bool isLoading(const std::string &url);
+        bool isLoading(const std::string &url, const ci::gl::Texture::Format &fmt=ci::gl::Texture::Format());
+        bool isLoading(TextureKey key);
         //! returns TRUE if image has been turned into a Texture
-        bool isLoaded(const std::string &url);
+        bool isLoaded(const std::string &url, const ci::gl::Texture::Format &fmt=ci::gl::Texture::Format());
+        bool isLoaded(TextureKey key);
+        
+        //! asynchronously fetches the tiles of a tiled image that cover a region, given in full resolution pixels,
+        //! drawn at a scale of screen pixels per image pixel. Returns the tiles that are ready, with loaded lower
+        //! resolution tiles standing in for the missing ones, see TileGrid::getDrawTiles(). Coarse tiles come first,
+        //! so sharper ones draw on top. Hold on to the result while drawing: the tiles that drop out of view get
+        //! garbage collected, and the ones still loading are taken back from the queue.
+        std::vector<TiledTexture> fetchTiles(const TilePyramidRef &pyramid, const ci::Area &region, float scale, ci::gl::Texture::Format fmt=ci::gl::Texture::Format());
+        
+        //! decodes a batch of images in the background ahead of time, queued under a single lock in the order given.
+        //! Images that already are a Texture in the given format are left out, so the handle tells when the others
+        //! are ready to be fetched.
+        LoadBatchRef prefetch(const std::vector<std::string> &urls, int priority = 0, const ci::gl::Texture::Format &fmt=ci::gl::Texture::Format());
+        
+        //! reads the size of an image from its file header without decoding or uploading it, e.g. to lay out a grid.
+        //! Blocks while it reads the header, see SurfaceStore::probe().
+        ImageInfo probe(const std::string &url) { return mSurfaceStore->probe( url ); }
+        //! probes all images of a directory on the loader threads, in the order loadImageDirectory() returns them
+        std::vector<ImageInfo> probeDirectory(const ci::fs::path &path) { return mSurfaceStore->probeDirectory( path ); }
         
         //! removes Textures from memory if no longer in use
         void garbageCollect();
         
+        //! call once per frame at the start of App::update(). Starts the frame's upload budget and swaps in the
+        //! textures that were reloaded from watched directories.
+        void update();
+        //! call at the end of App::draw(). Feeds the time the frame spent working since update() to the throttle,
+        //! which runs fewer decodes and uploads fewer bytes per frame in fetch() while frames run late, and more
+        //! with headroom. The wait for vsync or the frame rate limit comes after draw() and isn't counted, so an
+        //! idle frame shows its headroom.
+        void endFrame();
+        //! feeds the work time of a frame that was measured elsewhere, instead of update() and endFrame()
+        void addFrameWorkTime(double seconds) { mSurfaceStore->addFrameTime( seconds ); }
+        //! watches the directories loaded from now on through loadImageDirectory() or fetchImageDirectory().
+        //! update() then reloads the stored textures whose files change on disk in the background and swaps them
+        //! in under the same key. Textures of the same size are updated in place, so refs handed out earlier
+        //! show the new version too.
+        void setWatchingDirectories(bool watching) { mSurfaceStore->setWatchingDirectories( watching ); }
+        //! called from update() for every image file that was added, modified or removed in a watched directory
+        void setFileChangedHandler(const std::function<void (const DirectoryWatcher::Change &)> &handler) { mFileChangedHandler = handler; }
+        //! the frame time the throttle aims for, 1/60 s by default
+        void setTargetFrameTime(double seconds) { mSurfaceStore->setTargetFrameTime( seconds ); }
+        //! stops decoding and uploading in fetch() until resume(), e.g. during a scene transition. load() still works.
+        void pause();
+        void resume();
+        bool isPaused() const { return mPaused; }
+        
+        //! sets the byte budget of the cpu tier, which keeps the encoded bytes of recently evicted textures in RAM
+        //! so fetching them again skips the disk. The encoded bytes held for the stored textures, so they can be
+        //! demoted, count against it too. 256 MB by default, a budget of 0 disables the tier.
+        void setCpuTierBudget(size_t bytes);
+        size_t getCpuTierBudget() const { return mSurfaceStore->getCpuTierBudget(); }
+        size_t getCpuTierBytes() const { return mSurfaceStore->getCpuTierBytes(); }
+        
+        //! records which images get asked for during this run, to be saved as a manifest for the next launch
+        void setRecordingAccesses(bool recording) { mSurfaceStore->setRecordingAccesses( recording ); }
+        bool saveAccessManifest(const std::string &path) { return mSurfaceStore->saveAccessManifest( path ); }
+        //! decodes the images of a saved manifest in the background, in the order they were first asked for,
+        //! so the working set is ready before the first fetch(). Returns the number of images queued.
+        int prefetchAccessManifest(const std::string &path, size_t maxCount = 0) { return mSurfaceStore->prefetchAccessManifest( path, maxCount ); }
+        
+        //! hits and misses of load()/fetch() against the stored textures
+        CacheStats getGpuTierStats() const { return mGpuTierStats; }
+        //! hits and misses of texture loads against the cpu tier
+        CacheStats getCpuTierStats() const { return mSurfaceStore->getCpuTierStats(); }
+        
+        //! queue depth, stage latencies, bytes and cache counters of the load pipeline
+        LoadStats::Summary getStats();
+        //! gives access to tracing, e.g. getLoadStats().setTracingEnabled( true ) and saveChromeTrace( path ) later on
+        LoadStats& getLoadStats() { return mSurfaceStore->getLoadStats(); }
+        
+        //! the headless store underneath, e.g. to add search paths or to load surfaces without uploading them
+        SurfaceStoreRef getSurfaceStore() { return mSurfaceStore; }
+        
         // helpers:
         void drawAllStoredTextures( float width = 100.0f, float height = 100.0f );
         void status();
@@ -83,33 +188,77 @@ namespace rph {
             return int(mTextureRefsNonGarbageCollectable.size());
         };
         
-        std::vector<std::string> validFileExtension = {".png", ".jpg", ".jpeg"};
+        //! shared with the SurfaceStore
+        std::vector<std::string> &validFileExtension;
 		std::string keyForTexture(ci::gl::TextureRef ref) {
 			//loop through mTextureRefs, find texture
-			for (std::map<std::string, ci::gl::TextureRef>::iterator it = mTextureRefs.begin(); it != mTextureRefs.end(); ++it) {
+			for (auto it = mTextureRefs.begin(); it != mTextureRefs.end(); ++it) {
 				if (it->second == ref) {
-					return it->first;
+					return getUrl(it->first);
 				}
 			}
 			return "";
 		}
+        
+        //! reduces a texture format to the parameters that identify a cache entry
+        static FormatDescriptor describeFormat(const ci::gl::Texture::Format &fmt);
+        
       protected:
-        void loadImagesThreadFn();
-        bool hasValidFileExtension(ci::fs::path extension);
+        typedef SurfaceStore::DecodedImage DecodedImage;
+        
+        ci::gl::TextureRef uploadTexture(TextureKey key, const ci::Surface &surface);
+        //! puts a reloaded image into a stored texture
+        void replaceTexture(TextureKey key, const DecodedImage &decoded);
+        void updateWatched();
+        void recordAccess(TextureKey key);
+        //! stops waiting for a texture that isn't needed anymore
+        void cancelLoading(TextureKey key);
+        //! moves the encoded bytes of an evicted texture to the cpu tier
+        void demote(TextureKey key);
+        //! keeps the encoded bytes of a stored texture if they fit the cpu tier budget, in place of any earlier ones.
+        //! Formats of the same url share the bytes held for the first of them.
+        void holdEncoded(TextureKey key, const ci::BufferRef &encoded);
+        //! lets go of the bytes a texture holds, handing them back to the budget once no format of the url holds them
+        void releaseEncoded(TextureKey key);
+        //! lends the bytes held for another format of the url to its next decode, see SurfaceStore::lendEncoded()
+        void lendEncoded(TextureKey key);
+        
+        //! returns the texture format a handle was created with
+        ci::gl::Texture::Format getFormat(TextureKey key) const;
+        ci::gl::TextureRef storeTexture(TextureKey key, const ci::gl::TextureRef &texRef, const ci::BufferRef &encoded, bool isGarbageCollectable);
         
-        bool                                        mShouldQuit;
-        std::shared_ptr<std::thread>                mThread;
+        //! interned (url, format) pairs live in the SurfaceStore's registry, every container below is keyed by their handles
+        KeyRegistry&                                mKeys;
+        std::unordered_map<TextureKey, ci::gl::Texture::Format> mFormats;
         
-        //! queue of textures to load asynchronously
-        ConcurrentDeque<std::string>                mQueue;
-        ConcurrentDeque<std::string>                mLoadingQueue;
+        //! textures that have been requested from the SurfaceStore but not uploaded yet
+        std::unordered_set<TextureKey>              mLoading;
+        //! the tiles fetchTiles() asked for on its last call, for every pyramid that is still around
+        std::map<std::weak_ptr<TilePyramid>, std::vector<TextureKey>, std::owner_less<std::weak_ptr<TilePyramid>>> mTileRequests;
         
-        std::map<std::string, ci::gl::TextureRef>   mTextureRefs;
-        ConcurrentMap<std::string, ci::Surface>     mSurfaces;
+        std::unordered_map<TextureKey, ci::gl::TextureRef>  mTextureRefs;
+        CacheStats                                          mGpuTierStats;
+        
+        //! bytes fetch() uploaded since the last update(), checked against the throttle's upload budget
+        size_t                                              mUploadedBytes;
+        size_t                                              mUploadBudget;
+        //! when update() started the current frame, negative outside of one
+        double                                              mFrameStartTime;
+        bool                                                mPaused;
+        std::function<void (const DirectoryWatcher::Change &)> mFileChangedHandler;
+        
+        //! encoded bytes of a url, held once for all the formats it is stored in
+        struct HeldEncoded {
+            ci::BufferRef                   encoded;
+            //! the formats holding on to them, the tier gets them once the last one is evicted
+            std::unordered_set<TextureKey>  keys;
+        };
+        //! encoded bytes of the stored textures that fit the cpu tier budget, handed to the tier when they get evicted
+        std::unordered_map<uint32_t, HeldEncoded>           mEncodedRefs;
         
         //! list of Textures so they don't get garbage collected
     	//std::map<std::string, std::map<std::string, ci::gl::TextureRef>> mTempFetchTextureDirectory;
-        std::map<std::string, ci::gl::TextureRef> mTextureRefsNonGarbageCollectable;
+        std::unordered_map<TextureKey, ci::gl::TextureRef>  mTextureRefsNonGarbageCollectable;
 
     };
     
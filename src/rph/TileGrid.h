@@ -0,0 +1,182 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace rph {
+
+    //! a rectangle in pixels, x2 and y2 exclusive
+    struct PixelRect {
+        int32_t x1 = 0;
+        int32_t y1 = 0;
+        int32_t x2 = 0;
+        int32_t y2 = 0;
+
+        PixelRect() {}
+        PixelRect( int32_t x1, int32_t y1, int32_t x2, int32_t y2 ) : x1( x1 ), y1( y1 ), x2( x2 ), y2( y2 ) {}
+
+        int32_t getWidth() const { return x2 - x1; }
+        int32_t getHeight() const { return y2 - y1; }
+        bool    isEmpty() const { return x2 <= x1 || y2 <= y1; }
+        bool operator==( const PixelRect &rhs ) const { return x1 == rhs.x1 && y1 == rhs.y1 && x2 == rhs.x2 && y2 == rhs.y2; }
+    };
+
+    //! a tile of a level, level 0 being the full resolution
+    struct TileId {
+        uint32_t    level   = 0;
+        uint32_t    col     = 0;
+        uint32_t    row     = 0;
+
+        TileId() {}
+        TileId( uint32_t level, uint32_t col, uint32_t row ) : level( level ), col( col ), row( row ) {}
+
+        //! the tile that covers this one on the next lower resolution level
+        TileId      getParent() const { return TileId( level + 1, col / 2, row / 2 ); }
+        //! a single number for cache keys, room for 2^28 tiles in each direction
+        uint64_t    pack() const { return ( uint64_t( level ) << 56 ) | ( uint64_t( col ) << 28 ) | uint64_t( row ); }
+
+        bool operator==( const TileId &rhs ) const { return level == rhs.level && col == rhs.col && row == rhs.row; }
+        bool operator!=( const TileId &rhs ) const { return !( *this == rhs ); }
+    };
+
+    //! splits an image into square tiles, with lower resolution levels that halve the size each
+    //! until the whole image fits in a single tile. Only does the math, so it can be used without
+    //! any image, e.g. to work out what to load for a viewport.
+    class TileGrid {
+      public:
+        TileGrid() : mWidth( 0 ), mHeight( 0 ), mTileSize( 512 ), mLevels( 0 ) {}
+        TileGrid( int32_t width, int32_t height, int32_t tileSize = 512 )
+            : mWidth( width ), mHeight( height ), mTileSize( std::max( 1, tileSize ) ), mLevels( 1 )
+        {
+            while( getLevelWidth( mLevels - 1 ) > mTileSize || getLevelHeight( mLevels - 1 ) > mTileSize ) mLevels++;
+        }
+
+        int32_t     getWidth() const { return mWidth; }
+        int32_t     getHeight() const { return mHeight; }
+        int32_t     getTileSize() const { return mTileSize; }
+        int32_t     getLevelCount() const { return mLevels; }
+
+        //! every level halves the size of the one above, rounding up
+        int32_t     getLevelWidth( int32_t level ) const { return int32_t( ( int64_t( mWidth ) + ( int64_t( 1 ) << level ) - 1 ) >> level ); }
+        int32_t     getLevelHeight( int32_t level ) const { return int32_t( ( int64_t( mHeight ) + ( int64_t( 1 ) << level ) - 1 ) >> level ); }
+        int32_t     getColumns( int32_t level ) const { return ( getLevelWidth( level ) + mTileSize - 1 ) / mTileSize; }
+        int32_t     getRows( int32_t level ) const { return ( getLevelHeight( level ) + mTileSize - 1 ) / mTileSize; }
+        size_t      getTileCount() const {
+            size_t count = 0;
+            for( int32_t level = 0; level < mLevels; ++level ) count += size_t( getColumns( level ) ) * getRows( level );
+            return count;
+        }
+
+        //! the level with the lowest resolution that still has at least one image pixel per screen pixel,
+        //! scale being screen pixels per full resolution image pixel
+        int32_t     getLevelForScale( float scale ) const {
+            if( scale <= 0.0f ) return mLevels - 1;
+            int32_t level = int32_t( std::floor( std::log2( 1.0f / scale ) ) );
+            return std::min( std::max( level, 0 ), mLevels - 1 );
+        }
+
+        //! the pixels a tile covers within its level
+        PixelRect   getTileBounds( const TileId &tile ) const {
+            int32_t x1 = int32_t( tile.col ) * mTileSize;
+            int32_t y1 = int32_t( tile.row ) * mTileSize;
+            return PixelRect( x1, y1, std::min( x1 + mTileSize, getLevelWidth( tile.level ) ), std::min( y1 + mTileSize, getLevelHeight( tile.level ) ) );
+        }
+
+        //! the full resolution pixels a tile covers
+        PixelRect   getTileRegion( const TileId &tile ) const {
+            PixelRect bounds = getTileBounds( tile );
+            return PixelRect( std::min( bounds.x1 << tile.level, mWidth ), std::min( bounds.y1 << tile.level, mHeight ),
+                              std::min( bounds.x2 << tile.level, mWidth ), std::min( bounds.y2 << tile.level, mHeight ) );
+        }
+
+        //! the tiles of a level that cover a region given in full resolution pixels, row by row
+        std::vector<TileId> getTiles( const PixelRect &region, int32_t level ) const {
+            std::vector<TileId> tiles;
+            if( level < 0 || level >= mLevels ) return tiles;
+
+            // clip to the image and bring it down to the level, rounding outwards
+            int32_t x1 = std::max( region.x1, 0 ) >> level;
+            int32_t y1 = std::max( region.y1, 0 ) >> level;
+            int32_t x2 = int32_t( ( int64_t( std::min( region.x2, mWidth ) ) + ( int64_t( 1 ) << level ) - 1 ) >> level );
+            int32_t y2 = int32_t( ( int64_t( std::min( region.y2, mHeight ) ) + ( int64_t( 1 ) << level ) - 1 ) >> level );
+            if( x2 <= x1 || y2 <= y1 ) return tiles;
+
+            int32_t col1 = x1 / mTileSize, col2 = ( x2 - 1 ) / mTileSize;
+            int32_t row1 = y1 / mTileSize, row2 = ( y2 - 1 ) / mTileSize;
+            tiles.reserve( size_t( col2 - col1 + 1 ) * ( row2 - row1 + 1 ) );
+            for( int32_t row = row1; row <= row2; ++row ){
+                for( int32_t col = col1; col <= col2; ++col ) tiles.push_back( TileId( uint32_t( level ), uint32_t( col ), uint32_t( row ) ) );
+            }
+            return tiles;
+        }
+
+        //! the tiles that cover a region when it is drawn at a scale, see getLevelForScale()
+        std::vector<TileId> getTilesForScale( const PixelRect &region, float scale ) const {
+            return getTiles( region, getLevelForScale( scale ) );
+        }
+
+        //! what to draw for a set of wanted tiles: the ones that are loaded, and in place of each missing one the
+        //! closest lower resolution tile that is loaded, if any. Stand-ins come first, coarsest first, so the
+        //! sharper tiles draw on top of them.
+        std::vector<TileId> getDrawTiles( const std::vector<TileId> &tiles, const std::function<bool (const TileId &)> &isLoaded ) const {
+            std::vector<TileId> loaded;
+            std::vector<TileId> standIns;
+            for( const TileId &tile : tiles ){
+                if( isLoaded( tile ) ){
+                    loaded.push_back( tile );
+                    continue;
+                }
+                for( TileId parent = tile.getParent(); int32_t( parent.level ) < mLevels; parent = parent.getParent() ){
+                    if( !isLoaded( parent ) ) continue;
+                    // neighbouring tiles mostly share their stand-in, there are only a few of them
+                    if( std::find( standIns.begin(), standIns.end(), parent ) == standIns.end() ) standIns.push_back( parent );
+                    break;
+                }
+            }
+
+            std::stable_sort( standIns.begin(), standIns.end(), []( const TileId &a, const TileId &b ){ return a.level > b.level; } );
+            standIns.insert( standIns.end(), loaded.begin(), loaded.end() );
+            return standIns;
+        }
+
+      private:
+        int32_t     mWidth;
+        int32_t     mHeight;
+        int32_t     mTileSize;
+        int32_t     mLevels;
+    };
+
+} // namespace rph
+
+namespace std {
+    template<> struct hash<rph::TileId> {
+        size_t operator()( const rph::TileId &tile ) const { return std::hash<uint64_t>()( tile.pack() ); }
+    };
+} // namespace std
@@ -0,0 +1,240 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#include "rph/TilePyramid.h"
+
+#include "cinder/ImageIo.h"
+#include "cinder/Log.h"
+#include "cinder/Surface.h"
+
+#include <cstring>
+#include <fstream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace rph {
+
+    namespace {
+
+        const char *DESCRIPTOR_HEADER = "rph::TilePyramid 2";
+        const char *DESCRIPTOR_NAME = "tiles.txt";
+
+        //! modification time of a file in nanoseconds, or 0 if it can't be read
+        int64_t getModificationTime( const ci::fs::path &path ){
+#if defined( _WIN32 )
+            struct _stat64 info;
+            if( _stat64( path.string().c_str(), &info ) != 0 ) return 0;
+            return int64_t( info.st_mtime ) * 1000000000;
+#else
+            struct stat info;
+            if( stat( path.string().c_str(), &info ) != 0 ) return 0;
+    #if defined( __APPLE__ )
+            return int64_t( info.st_mtimespec.tv_sec ) * 1000000000 + info.st_mtimespec.tv_nsec;
+    #else
+            return int64_t( info.st_mtim.tv_sec ) * 1000000000 + info.st_mtim.tv_nsec;
+    #endif
+#endif
+        }
+
+        //! receives the decoded source row by row, top to bottom, and writes out a band of tiles whenever
+        //! it has tileSize rows of a level, so only one band per level is held in memory. Every pair of
+        //! rows is averaged down into the next level on the way.
+        class TileWriter : public ci::ImageTarget {
+          public:
+            TileWriter( const TileGrid &grid, bool alpha, const ci::fs::path &dir, const std::string &extension )
+            : mGrid( grid ), mAlpha( alpha ), mChannels( alpha ? 4 : 3 ), mDir( dir ), mExtension( extension ), mLastRow( -1 )
+            {
+                setSize( grid.getWidth(), grid.getHeight() );
+                setColorModel( ImageIo::CM_RGB );
+                setDataType( ImageIo::UINT8 );
+                setChannelOrder( alpha ? ImageIo::RGBA : ImageIo::RGB );
+
+                for( int32_t i = 0; i < grid.getLevelCount(); ++i ){
+                    Level level;
+                    level.width = grid.getLevelWidth( i );
+                    level.height = grid.getLevelHeight( i );
+                    level.band = ci::Surface8u( level.width, std::min( grid.getTileSize(), level.height ), alpha, alpha ? ci::SurfaceChannelOrder::RGBA : ci::SurfaceChannelOrder::RGB );
+                    level.filled = 0;
+                    level.rowsDone = 0;
+                    level.pending.resize( size_t( level.width ) * mChannels );
+                    level.hasPending = false;
+                    level.reduced.resize( size_t( grid.getLevelWidth( i + 1 ) ) * mChannels );
+                    mLevels.push_back( level );
+                    ci::fs::create_directories( dir / std::to_string( i ) );
+                }
+            }
+
+            void* getRowPointer( int32_t row ) override {
+                // asking for the next row means the previous one is complete
+                if( mLastRow >= 0 && row != mLastRow ) addRow( 0, rowPointer( 0, mLevels[0].filled ) );
+                mLastRow = row;
+                return rowPointer( 0, mLevels[0].filled );
+            }
+
+            void finalize() override {
+                if( mLastRow >= 0 ) addRow( 0, rowPointer( 0, mLevels[0].filled ) );
+                mLastRow = -1;
+            }
+
+          private:
+            struct Level {
+                int32_t                 width;
+                int32_t                 height;
+                ci::Surface8u           band;
+                int32_t                 filled;
+                int32_t                 rowsDone;
+                //! the even row waiting for its odd partner to be averaged into the next level
+                std::vector<uint8_t>    pending;
+                bool                    hasPending;
+                std::vector<uint8_t>    reduced;
+            };
+
+            uint8_t* rowPointer( size_t level, int32_t bandRow ){
+                return mLevels[level].band.getData() + bandRow * mLevels[level].band.getRowBytes();
+            }
+
+            void addRow( size_t index, const uint8_t *row ){
+                Level &level = mLevels[index];
+                uint8_t *bandRow = rowPointer( index, level.filled );
+                if( row != bandRow ) std::memcpy( bandRow, row, size_t( level.width ) * mChannels );
+
+                const bool isLastRow = level.rowsDone + 1 == level.height;
+                if( index + 1 < mLevels.size() ){
+                    if( level.hasPending ){
+                        reduce( index, level.pending.data(), bandRow );
+                        level.hasPending = false;
+                    } else if( isLastRow ){
+                        // odd height, the last row has no partner
+                        reduce( index, bandRow, bandRow );
+                    } else {
+                        std::memcpy( level.pending.data(), bandRow, level.pending.size() );
+                        level.hasPending = true;
+                    }
+                }
+
+                level.filled++;
+                level.rowsDone++;
+                if( level.filled == level.band.getHeight() || isLastRow ) writeBand( index );
+            }
+
+            //! averages two rows and every pair of pixels in them into a row of the next level
+            void reduce( size_t index, const uint8_t *row0, const uint8_t *row1 ){
+                Level &level = mLevels[index];
+                const int32_t width = mLevels[index + 1].width;
+                for( int32_t x = 0; x < width; ++x ){
+                    const size_t a = size_t( 2 * x ) * mChannels;
+                    const size_t b = size_t( std::min( 2 * x + 1, level.width - 1 ) ) * mChannels;
+                    for( int c = 0; c < mChannels; ++c ){
+                        level.reduced[ size_t( x ) * mChannels + c ] = uint8_t( ( row0[a + c] + row0[b + c] + row1[a + c] + row1[b + c] + 2 ) / 4 );
+                    }
+                }
+                addRow( index + 1, level.reduced.data() );
+            }
+
+            void writeBand( size_t index ){
+                Level &level = mLevels[index];
+                const int32_t tileSize = mGrid.getTileSize();
+                const uint32_t bandRow = uint32_t( ( level.rowsDone - 1 ) / tileSize );
+
+                for( int32_t col = 0; col < mGrid.getColumns( int32_t( index ) ); ++col ){
+                    const int32_t x1 = col * tileSize;
+                    const int32_t width = std::min( tileSize, level.width - x1 );
+                    ci::Surface8u tile( width, level.filled, mAlpha, mAlpha ? ci::SurfaceChannelOrder::RGBA : ci::SurfaceChannelOrder::RGB );
+                    for( int32_t y = 0; y < level.filled; ++y ){
+                        std::memcpy( tile.getData() + y * tile.getRowBytes(), rowPointer( index, y ) + size_t( x1 ) * mChannels, size_t( width ) * mChannels );
+                    }
+                    TileId id( uint32_t( index ), uint32_t( col ), bandRow );
+                    ci::writeImage( mDir / std::to_string( index ) / ( std::to_string( id.col ) + "_" + std::to_string( id.row ) + "." + mExtension ), tile );
+                }
+                level.filled = 0;
+            }
+
+            TileGrid            mGrid;
+            bool                mAlpha;
+            int                 mChannels;
+            ci::fs::path        mDir;
+            std::string         mExtension;
+            int32_t             mLastRow;
+            std::vector<Level>  mLevels;
+        };
+
+    } // anonymous namespace
+
+    TilePyramid::TilePyramid( const TileGrid &grid, const ci::fs::path &cacheDir, const std::string &extension )
+    : mGrid( grid ), mCacheDir( cacheDir ), mExtension( extension )
+    {
+    }
+
+    TilePyramidRef TilePyramid::create( const ci::fs::path &source, const ci::fs::path &cacheDir, int32_t tileSize ){
+        if( !ci::fs::exists( source ) ){
+            CI_LOG_E( "rph::TilePyramid - ERROR - (" << source << ") does not exist!" );
+            return TilePyramidRef();
+        }
+        const uint64_t sourceBytes = uint64_t( ci::fs::file_size( source ) );
+        const int64_t sourceModified = getModificationTime( source );
+        const std::string sourcePath = ci::fs::absolute( source ).string();
+
+        // reuse the tiles if they were cut from the same file, unchanged since, with the same tile size.
+        // Edits often keep the size, e.g. in uncompressed formats, so the modification time has to match too.
+        std::ifstream descriptor( ( cacheDir / DESCRIPTOR_NAME ).string().c_str() );
+        std::string header;
+        if( descriptor.is_open() && std::getline( descriptor, header ) && header == DESCRIPTOR_HEADER ){
+            int32_t width = 0, height = 0, size = 0;
+            uint64_t bytes = 0;
+            int64_t modified = 0;
+            std::string extension, path;
+            if( descriptor >> width >> height >> size >> extension >> bytes >> modified && std::getline( descriptor >> std::ws, path )
+                && size == tileSize && bytes == sourceBytes && modified == sourceModified && path == sourcePath ){
+                return TilePyramidRef( new TilePyramid( TileGrid( width, height, size ), cacheDir, extension ) );
+            }
+        }
+        descriptor.close();
+
+        TileGrid grid;
+        std::string extension;
+        try {
+            ci::ImageSourceRef image = ci::loadImage( ci::loadFile( source ) );
+            // jpeg tiles are a lot smaller, unless there is alpha to keep
+            extension = image->hasAlpha() ? "png" : "jpg";
+            grid = TileGrid( image->getWidth(), image->getHeight(), tileSize );
+            image->load( ci::ImageTargetRef( new TileWriter( grid, image->hasAlpha(), cacheDir, extension ) ) );
+        } catch( std::exception &exc ) {
+            CI_LOG_E( "rph::TilePyramid - ERROR - could not cut (" << source << "): " << exc.what() );
+            return TilePyramidRef();
+        }
+
+        // written last, so an interrupted cut starts over next time
+        std::ofstream out( ( cacheDir / DESCRIPTOR_NAME ).string().c_str() );
+        out << DESCRIPTOR_HEADER << "\n" << grid.getWidth() << " " << grid.getHeight() << " " << grid.getTileSize() << " " << extension << " " << sourceBytes << " " << sourceModified << "\n" << sourcePath << "\n";
+
+        CI_LOG_I( "rph::TilePyramid - cut (" << source << ") into " << grid.getTileCount() << " tiles in " << grid.getLevelCount() << " levels" );
+        return TilePyramidRef( new TilePyramid( grid, cacheDir, extension ) );
+    }
+
+    std::string TilePyramid::getTileUrl( const TileId &tile ) const {
+        return ( mCacheDir / std::to_string( tile.level ) / ( std::to_string( tile.col ) + "_" + std::to_string( tile.row ) + "." + mExtension ) ).string();
+    }
+
+} // namespace rph
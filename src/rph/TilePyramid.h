@@ -0,0 +1,63 @@
+/*
+ Copyright (c) 2014 Red Paper Heart Inc.
+
+ This code is intended for use with the Cinder C++ library: http://libcinder.org
+
+ Permission is hereby granted, free of charge, to any person obtaining a copy of
+ this software and associated documentation files (the "Software"), to deal in
+ the Software without restriction, including without limitation the rights to
+ use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies
+ of the Software, and to permit persons to whom the Software is furnished to do
+ so, subject to the following conditions:
+
+ The above copyright notice and this permission notice shall be included in all
+ copies or substantial portions of the Software.
+
+ THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ SOFTWARE.
+*/
+
+#pragma once
+
+#include "cinder/Filesystem.h"
+
+#include "rph/TileGrid.h"
+
+#include <memory>
+#include <string>
+
+namespace rph {
+
+    typedef std::shared_ptr<class TilePyramid> TilePyramidRef;
+
+    //! an image that is too large to load at once, cut into tile files with lower resolution levels.
+    //! Every tile is an ordinary image file, so the stores load, cache and evict them like any other url
+    //! and only the tiles of the visible region take up memory.
+    class TilePyramid {
+      public:
+        //! opens the tiles of an image in cacheDir, cutting them first if they don't exist or don't match the source.
+        //! Cutting decodes the whole source into RAM, so its peak is width * height * channels bytes for the image
+        //! plus a band of tileSize rows for every level. Do it ahead of time or off the main thread for large images.
+        //! Returns NULL if the source can't be read.
+        static TilePyramidRef create( const ci::fs::path &source, const ci::fs::path &cacheDir, int32_t tileSize = 512 );
+
+        const TileGrid&     getGrid() const { return mGrid; }
+        const ci::fs::path& getCacheDir() const { return mCacheDir; }
+
+        //! the file a tile is stored in, pass it to fetch()
+        std::string         getTileUrl( const TileId &tile ) const;
+
+      protected:
+        TilePyramid( const TileGrid &grid, const ci::fs::path &cacheDir, const std::string &extension );
+
+        TileGrid        mGrid;
+        ci::fs::path    mCacheDir;
+        std::string     mExtension;
+    };
+
+} // namespace rph